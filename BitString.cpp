@@ -6,10 +6,1698 @@
 #include <span>         // std::span
 #include <new>          // std::launder
 #include <algorithm>
+#include <array>
+#include <utility>      // std::integer_sequence
+#include <vector>
+#include <thread>
 #include <assert.h>
 
+#if defined(_M_X64) || defined(__x86_64__)
+#define BITSTRING_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>     // __cpuidex, _xgetbv
+#else
+#include <cpuid.h>      // __cpuid_count
+#endif
+#endif
+
 #include "BitString.h"
 
+using namespace BitStringDetail;
+
+// MSVC allows intrinsics of any instruction set in any function, whereas GCC/clang require the
+// function to be marked with the target instruction set (without enabling it for the whole file).
+#if defined(_MSC_VER) && !defined(__clang__)
+#define BITSTRING_TARGET_AVX2
+#define BITSTRING_TARGET_BMI2
+#define BITSTRING_TARGET_POPCNT
+#else
+#define BITSTRING_TARGET_AVX2 __attribute__((target("avx2")))
+#define BITSTRING_TARGET_BMI2 __attribute__((target("bmi2")))
+#define BITSTRING_TARGET_POPCNT __attribute__((target("popcnt")))
+#endif
+
+// Software prefetch of the cache line holding an address, only a hint.
+#if defined(_MSC_VER) && !defined(__clang__)
+#if defined(_M_ARM64)
+#include <intrin.h>     // __prefetch
+#define BITSTRING_PREFETCH(address) __prefetch(address)
+#else
+#include <xmmintrin.h>  // _mm_prefetch
+#define BITSTRING_PREFETCH(address) _mm_prefetch(reinterpret_cast<char const*>(address), _MM_HINT_T0)
+#endif
+#else
+#define BITSTRING_PREFETCH(address) __builtin_prefetch(address)
+#endif
+
+namespace
+{
+    // Width-specialized kernels that unpack/pack blocks of 32 elements, where every shift and mask is
+    // a compile-time constant (in the style of FastPFor's bit packing routines). A block of 32 elements
+    // always occupies exactly bitSize 32-bit words (4 * bitSize bytes), so consecutive blocks stay
+    // byte aligned if the first one is.
+    //
+    // e.g. bitSize = 13, LE:
+    //
+    //      word 0:  [ccccccbbbbbbbbbbbbbaaaaaaaaaaaaa]  element 2 straddles into word 1
+    //      word 1:  [..........eeeeeeeeeeeeedddddddcc]
+    //
+    // e.g. bitSize = 13, BE:
+    //
+    //      word 0:  [aaaaaaaaaaaaabbbbbbbbbbbbbcccccc]  element 2 straddles into word 1
+    //      word 1:  [ccdddddddddddddeeeeeeeeeeeee....]
+    //
+    constexpr size_t bitStringBlockElementCount = 32;
+
+    template <uint32_t bitSize, bool isBeData, uint32_t elementIndex>
+    BITSTRING_FORCEINLINE uint32_t UnpackBlockElement(uint32_t const* words)
+    {
+        constexpr uint32_t bitIndex = elementIndex * bitSize;
+        constexpr uint32_t wordIndex = bitIndex / 32;
+        constexpr uint32_t bitInWord = bitIndex % 32;
+        constexpr uint32_t elementMask = static_cast<uint32_t>((uint64_t(1) << bitSize) - 1);
+        constexpr bool straddlesWords = (bitInWord + bitSize > 32);
+
+        if constexpr (isBeData)
+        {
+            if constexpr (straddlesWords)
+            {
+                return ((words[wordIndex] << (bitInWord + bitSize - 32)) | (words[wordIndex + 1] >> (64 - bitInWord - bitSize))) & elementMask;
+            }
+            else
+            {
+                return (words[wordIndex] >> (32 - bitInWord - bitSize)) & elementMask;
+            }
+        }
+        else
+        {
+            if constexpr (straddlesWords)
+            {
+                return ((words[wordIndex] >> bitInWord) | (words[wordIndex + 1] << (32 - bitInWord))) & elementMask;
+            }
+            else
+            {
+                return (words[wordIndex] >> bitInWord) & elementMask;
+            }
+        }
+    }
+
+    template <uint32_t bitSize, bool isBeData, uint32_t elementIndex>
+    BITSTRING_FORCEINLINE void PackBlockElement(uint32_t* words, uint32_t value)
+    {
+        constexpr uint32_t bitIndex = elementIndex * bitSize;
+        constexpr uint32_t wordIndex = bitIndex / 32;
+        constexpr uint32_t bitInWord = bitIndex % 32;
+        constexpr uint32_t elementMask = static_cast<uint32_t>((uint64_t(1) << bitSize) - 1);
+        constexpr bool straddlesWords = (bitInWord + bitSize > 32);
+        value &= elementMask;
+
+        if constexpr (isBeData)
+        {
+            if constexpr (straddlesWords)
+            {
+                words[wordIndex] |= value >> (bitInWord + bitSize - 32);
+                words[wordIndex + 1] |= value << (64 - bitInWord - bitSize);
+            }
+            else
+            {
+                words[wordIndex] |= value << (32 - bitInWord - bitSize);
+            }
+        }
+        else
+        {
+            words[wordIndex] |= value << bitInWord;
+            if constexpr (straddlesWords)
+            {
+                words[wordIndex + 1] |= value >> (32 - bitInWord);
+            }
+        }
+    }
+
+    template <uint32_t bitSize, bool isBeData, uint32_t... elementIndices>
+    BITSTRING_FORCEINLINE void UnpackBlockElements(uint32_t const* words, uint32_t* output, std::integer_sequence<uint32_t, elementIndices...>)
+    {
+        ((output[elementIndices] = UnpackBlockElement<bitSize, isBeData, elementIndices>(words)), ...);
+    }
+
+    template <uint32_t bitSize, bool isBeData, uint32_t... elementIndices>
+    BITSTRING_FORCEINLINE void PackBlockElements(uint32_t* words, uint32_t const* input, std::integer_sequence<uint32_t, elementIndices...>)
+    {
+        (PackBlockElement<bitSize, isBeData, elementIndices>(words, input[elementIndices]), ...);
+    }
+
+    template <uint32_t bitSize, bool isBeData>
+    void UnpackBlock(uint8_t const* input, uint32_t* output)
+    {
+        uint32_t words[bitSize];
+        for (uint32_t i = 0; i < bitSize; ++i)
+        {
+            words[i] = isBeData ? LoadUnalignedBe32(input + i * sizeof(uint32_t)) : LoadUnalignedLe32(input + i * sizeof(uint32_t));
+        }
+        UnpackBlockElements<bitSize, isBeData>(words, output, std::make_integer_sequence<uint32_t, bitStringBlockElementCount>{});
+    }
+
+    template <uint32_t bitSize, bool isBeData>
+    void PackBlock(uint32_t const* input, uint8_t* output)
+    {
+        uint32_t words[bitSize] = {};
+        PackBlockElements<bitSize, isBeData>(words, input, std::make_integer_sequence<uint32_t, bitStringBlockElementCount>{});
+        for (uint32_t i = 0; i < bitSize; ++i)
+        {
+            isBeData ? StoreUnalignedBe32(output + i * sizeof(uint32_t), words[i]) : StoreUnalignedLe32(output + i * sizeof(uint32_t), words[i]);
+        }
+    }
+
+    using UnpackBlockFunction = void (*)(uint8_t const* input, uint32_t* output);
+    using PackBlockFunction = void (*)(uint32_t const* input, uint8_t* output);
+
+    // Tables indexed by bitSize (0 unused), for each of LE and BE.
+    template <bool isBeData, uint32_t... bitSizes>
+    constexpr std::array<UnpackBlockFunction, sizeof...(bitSizes)> MakeUnpackBlockTable(std::integer_sequence<uint32_t, bitSizes...>)
+    {
+        return {(bitSizes == 0 ? nullptr : &UnpackBlock<std::max(bitSizes, 1u), isBeData>)...};
+    }
+
+    template <bool isBeData, uint32_t... bitSizes>
+    constexpr std::array<PackBlockFunction, sizeof...(bitSizes)> MakePackBlockTable(std::integer_sequence<uint32_t, bitSizes...>)
+    {
+        return {(bitSizes == 0 ? nullptr : &PackBlock<std::max(bitSizes, 1u), isBeData>)...};
+    }
+
+    constexpr std::array<UnpackBlockFunction, 33> unpackBlockFunctions[2] =
+    {
+        MakeUnpackBlockTable<false>(std::make_integer_sequence<uint32_t, 33>{}),
+        MakeUnpackBlockTable<true>(std::make_integer_sequence<uint32_t, 33>{}),
+    };
+
+    constexpr std::array<PackBlockFunction, 33> packBlockFunctions[2] =
+    {
+        MakePackBlockTable<false>(std::make_integer_sequence<uint32_t, 33>{}),
+        MakePackBlockTable<true>(std::make_integer_sequence<uint32_t, 33>{}),
+    };
+
+    // Returns how many whole 32-element blocks fit within both the values and data, or 0 if the
+    // bit offset is not byte aligned.
+    inline size_t GetBitStringBlockCount(size_t dataByteSize, size_t bitOffset, size_t bitSize, size_t elementCount)
+    {
+        const size_t dataByteOffsetBegin = bitOffset / CHAR_BIT;
+        if ((bitOffset & 7) != 0 || dataByteOffsetBegin >= dataByteSize)
+        {
+            return 0;
+        }
+        const size_t blockByteSize = bitSize * (bitStringBlockElementCount / CHAR_BIT);
+        return std::min(elementCount / bitStringBlockElementCount, (dataByteSize - dataByteOffsetBegin) / blockByteSize);
+    }
+    struct CpuFeatures
+    {
+        bool hasAvx2;
+        bool hasPopcnt;
+        bool hasFastBmi2; // pext/pdep exist *and* are not microcoded (slow on AMD before Zen 3).
+    };
+
+    CpuFeatures DetectCpuFeatures()
+    {
+        CpuFeatures cpuFeatures = {};
+
+        #if BITSTRING_X64
+        auto getCpuid = [](uint32_t leaf, uint32_t subleaf, /*out*/ uint32_t (&registers)[4]) -> void
+        {
+            #if defined(_MSC_VER)
+            __cpuidex(reinterpret_cast<int*>(registers), int(leaf), int(subleaf));
+            #else
+            __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+            #endif
+        };
+
+        uint32_t registers[4] = {}; // eax, ebx, ecx, edx
+        getCpuid(0, 0, /*out*/ registers);
+        const uint32_t maximumLeaf = registers[0];
+        if (maximumLeaf < 7)
+        {
+            return cpuFeatures;
+        }
+
+        // The vendor string is split across ebx, edx, ecx.
+        char vendor[12];
+        memcpy(vendor + 0, &registers[1], 4);
+        memcpy(vendor + 4, &registers[3], 4);
+        memcpy(vendor + 8, &registers[2], 4);
+        const bool isAmdOrHygon = (memcmp(vendor, "AuthenticAMD", 12) == 0 || memcmp(vendor, "HygonGenuine", 12) == 0);
+
+        // AVX2 needs both the CPU support and the OS to save the upper ymm register state (XCR0 bits 1-2).
+        getCpuid(1, 0, /*out*/ registers);
+        const uint32_t baseFamily = (registers[0] >> 8) & 0xF;
+        const uint32_t family = (baseFamily == 0xF) ? baseFamily + ((registers[0] >> 20) & 0xFF) : baseFamily;
+        const bool hasOsxsave = (registers[2] & (1u << 27)) != 0;
+        const bool hasAvx = (registers[2] & (1u << 28)) != 0;
+        uint64_t xcr0 = 0;
+        if (hasOsxsave)
+        {
+            #if defined(_MSC_VER)
+            xcr0 = _xgetbv(0);
+            #else
+            uint32_t xcr0Low, xcr0High;
+            __asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+            xcr0 = (uint64_t(xcr0High) << 32) | xcr0Low;
+            #endif
+        }
+        const bool osSavesYmm = (xcr0 & 0x6) == 0x6;
+        cpuFeatures.hasPopcnt = (registers[2] & (1u << 23)) != 0;
+
+        getCpuid(7, 0, /*out*/ registers);
+        cpuFeatures.hasAvx2 = hasAvx && osSavesYmm && (registers[1] & (1u << 5)) != 0;
+
+        // Zen 1/2 (families 17h/18h) and earlier AMD implement pext/pdep in microcode, taking
+        // hundreds of cycles for masks with many runs, far slower than the portable fallback.
+        const bool hasBmi2 = (registers[1] & (1u << 8)) != 0;
+        const bool hasMicrocodedBmi2 = isAmdOrHygon && family < 0x19;
+        cpuFeatures.hasFastBmi2 = hasBmi2 && !hasMicrocodedBmi2;
+        #endif
+
+        return cpuFeatures;
+    }
+
+    CpuFeatures const& GetCpuFeatures()
+    {
+        static const CpuFeatures cpuFeatures = DetectCpuFeatures();
+        return cpuFeatures;
+    }
+
+    // Portable pext/pdep, processing one contiguous run of mask bits (one field) per iteration
+    // rather than one bit per iteration.
+    uint64_t GatherBitsPortable(uint64_t value, uint64_t fieldMask)
+    {
+        uint64_t result = 0;
+        uint32_t resultBitOffset = 0;
+        while (fieldMask != 0)
+        {
+            const uint32_t runBitOffset = std::countr_zero(fieldMask);
+            const uint32_t runBitSize = std::countr_one(fieldMask >> runBitOffset);
+            const uint64_t runMask = (runBitSize >= 64) ? ~uint64_t(0) : (uint64_t(1) << runBitSize) - 1;
+            result |= ((value >> runBitOffset) & runMask) << resultBitOffset;
+            resultBitOffset += runBitSize;
+            fieldMask &= ~(runMask << runBitOffset);
+        }
+        return result;
+    }
+
+    uint64_t ScatterBitsPortable(uint64_t value, uint64_t fieldMask)
+    {
+        uint64_t result = 0;
+        while (fieldMask != 0)
+        {
+            const uint32_t runBitOffset = std::countr_zero(fieldMask);
+            const uint32_t runBitSize = std::countr_one(fieldMask >> runBitOffset);
+            const uint64_t runMask = (runBitSize >= 64) ? ~uint64_t(0) : (uint64_t(1) << runBitSize) - 1;
+            result |= (value & runMask) << runBitOffset;
+            value = (runBitSize >= 64) ? 0 : value >> runBitSize;
+            fieldMask &= ~(runMask << runBitOffset);
+        }
+        return result;
+    }
+
+    #if BITSTRING_X64
+    BITSTRING_TARGET_BMI2
+    void GatherBitsArrayBmi2(uint64_t const* values, uint64_t fieldMask, uint64_t* results, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            results[i] = _pext_u64(values[i], fieldMask);
+        }
+    }
+
+    BITSTRING_TARGET_BMI2
+    void ScatterBitsArrayBmi2(uint64_t const* values, uint64_t fieldMask, uint64_t* results, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            results[i] = _pdep_u64(values[i], fieldMask);
+        }
+    }
+    #endif
+
+    #if BITSTRING_X64
+    // Unpacks groups of 8 elements per iteration using AVX2, returning how many elements were read.
+    // Since 8 elements of bitSize bits occupy exactly bitSize bytes, every group has the same bit
+    // phase relative to its first byte, and so the same byte shuffle and shift amounts, which are
+    // computed once up front.
+    //
+    // For bitSize <= 24, each element fits within 4 bytes (7 + 24 <= 32 bits), and 4 consecutive
+    // elements fit within 16 bytes. So each 128-bit lane loads 16 bytes, and vpshufb gathers the 4
+    // bytes of each element into a 32-bit lane (byte reversed for BE), then vpsrlvd shifts each
+    // element down by its own amount:
+    //
+    //      e.g. bitSize = 13, bitOffset phase = 3, LE:
+    //      element j bit range:    3-15, 16-28, 29-41, 42-54 | 55-67, 68-80, 81-93, 94-106
+    //      element j first byte:   0,    2,     3,     5     | 6,     8,     10,    11
+    //      element j shift:        3,    0,     5,     2     | 7,     4,     1,     6
+    //
+    // For bitSize 25-32, an element can span 5 bytes, so each element is instead gathered into a
+    // 64-bit lane with vpsrlvq, 2 elements per 128-bit lane across two registers, then narrowed.
+    //
+    BITSTRING_TARGET_AVX2
+    size_t ReadBitStringArrayAvx2(
+        uint8_t const* data,
+        size_t dataByteSize,
+        size_t bitOffset,
+        uint32_t bitSize, // 1 to 32
+        bool isBeData,
+        uint32_t* values,
+        size_t elementCount
+    )
+    {
+        constexpr size_t groupElementCount = 8;
+        const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+        const size_t groupByteSize = bitSize; // 8 elements * bitSize bits / 8 bits per byte.
+        const uint32_t elementMask32 = static_cast<uint32_t>((uint64_t(1) << bitSize) - 1);
+
+        uint32_t elementByteOffsets[groupElementCount];
+        uint32_t elementShifts[groupElementCount];
+        for (uint32_t j = 0; j < groupElementCount; ++j)
+        {
+            const uint32_t relativeBitOffset = bitPhase + j * bitSize;
+            elementByteOffsets[j] = relativeBitOffset / CHAR_BIT;
+            elementShifts[j] = relativeBitOffset & 7;
+        }
+
+        alignas(32) uint8_t shuffleBytes[2][32];
+        alignas(32) uint32_t dwordShiftAmounts[8];
+        alignas(32) uint64_t qwordShiftAmounts[2][4];
+        const bool useDwordLanes = (bitSize <= 24);
+        const uint32_t laneElementCount = useDwordLanes ? 4 : 2;
+        const uint32_t laneByteSize = useDwordLanes ? 4 : 8;
+        const uint32_t registerCount = useDwordLanes ? 1 : 2;
+
+        // Build the shuffle controls and shift amounts for each lane element.
+        uint32_t laneLoadOffsets[4];
+        for (uint32_t lane = 0; lane < 2 * registerCount; ++lane)
+        {
+            const uint32_t laneFirstElement = lane * laneElementCount;
+            laneLoadOffsets[lane] = elementByteOffsets[laneFirstElement];
+            for (uint32_t k = 0; k < laneElementCount; ++k)
+            {
+                const uint32_t j = laneFirstElement + k;
+                const uint32_t firstByte = elementByteOffsets[j] - laneLoadOffsets[lane];
+                for (uint32_t b = 0; b < laneByteSize; ++b)
+                {
+                    // LE elements have their first byte lowest, whereas BE elements have it highest.
+                    const uint32_t destinationByte = (lane & 1) * 16 + k * laneByteSize + (isBeData ? laneByteSize - 1 - b : b);
+                    shuffleBytes[lane / 2][destinationByte] = static_cast<uint8_t>(firstByte + b);
+                }
+
+                const uint32_t shift = isBeData ? laneByteSize * CHAR_BIT - elementShifts[j] - bitSize : elementShifts[j];
+                if (useDwordLanes)
+                {
+                    dwordShiftAmounts[j] = shift;
+                }
+                else
+                {
+                    qwordShiftAmounts[lane / 2][(lane & 1) * 2 + k] = shift;
+                }
+            }
+        }
+
+        // Every load reads 16 bytes, the last one starting at the final lane's load offset.
+        const size_t maximumLoadEnd = laneLoadOffsets[2 * registerCount - 1] + 16;
+        const size_t dataByteOffsetBegin = bitOffset / CHAR_BIT;
+        if (dataByteOffsetBegin + maximumLoadEnd > dataByteSize)
+        {
+            return 0;
+        }
+        const size_t groupCount = std::min(
+            elementCount / groupElementCount,
+            (dataByteSize - dataByteOffsetBegin - maximumLoadEnd) / groupByteSize + 1
+        );
+
+        uint8_t const* input = data + dataByteOffsetBegin;
+        uint32_t* output = values;
+        const __m256i shuffle0 = _mm256_load_si256(reinterpret_cast<__m256i const*>(shuffleBytes[0]));
+        const __m256i shift0 = useDwordLanes
+            ? _mm256_load_si256(reinterpret_cast<__m256i const*>(dwordShiftAmounts))
+            : _mm256_load_si256(reinterpret_cast<__m256i const*>(qwordShiftAmounts[0]));
+
+        if (useDwordLanes)
+        {
+            const __m256i elementMask = _mm256_set1_epi32(int32_t(elementMask32));
+            for (size_t i = 0; i < groupCount; ++i, input += groupByteSize, output += groupElementCount)
+            {
+                const __m256i bytes = _mm256_loadu2_m128i(
+                    reinterpret_cast<__m128i const*>(input + laneLoadOffsets[1]),
+                    reinterpret_cast<__m128i const*>(input + laneLoadOffsets[0])
+                );
+                const __m256i elements = _mm256_and_si256(_mm256_srlv_epi32(_mm256_shuffle_epi8(bytes, shuffle0), shift0), elementMask);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), elements);
+            }
+        }
+        else
+        {
+            const __m256i shuffle1 = _mm256_load_si256(reinterpret_cast<__m256i const*>(shuffleBytes[1]));
+            const __m256i shift1 = _mm256_load_si256(reinterpret_cast<__m256i const*>(qwordShiftAmounts[1]));
+            const __m256i elementMask = _mm256_set1_epi64x(int64_t(elementMask32));
+            const __m256i narrowingPermutation = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+            for (size_t i = 0; i < groupCount; ++i, input += groupByteSize, output += groupElementCount)
+            {
+                const __m256i bytes0 = _mm256_loadu2_m128i(
+                    reinterpret_cast<__m128i const*>(input + laneLoadOffsets[1]),
+                    reinterpret_cast<__m128i const*>(input + laneLoadOffsets[0])
+                );
+                const __m256i bytes1 = _mm256_loadu2_m128i(
+                    reinterpret_cast<__m128i const*>(input + laneLoadOffsets[3]),
+                    reinterpret_cast<__m128i const*>(input + laneLoadOffsets[2])
+                );
+                const __m256i elements0 = _mm256_and_si256(_mm256_srlv_epi64(_mm256_shuffle_epi8(bytes0, shuffle0), shift0), elementMask);
+                const __m256i elements1 = _mm256_and_si256(_mm256_srlv_epi64(_mm256_shuffle_epi8(bytes1, shuffle1), shift1), elementMask);
+
+                // Narrow the 64-bit elements to 32 bits: elements 0-3 from the first, 4-7 from the second.
+                const __m256i elements = _mm256_blend_epi32(
+                    _mm256_permutevar8x32_epi32(elements0, narrowingPermutation),
+                    _mm256_permutevar8x32_epi32(elements1, narrowingPermutation),
+                    0xF0
+                );
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), elements);
+            }
+        }
+
+        return groupCount * groupElementCount;
+    }
+    #endif
+
+    // Packs the 7-bit groups of up to 8 varint bytes (LE byte order) into contiguous bits, discarding
+    // each byte's high continuation bit, by merging pairs of groups, then pairs of pairs...
+    //
+    //      bytes:   [.hhhhhhh.ggggggg.fffffff.eeeeeee.ddddddd.ccccccc.bbbbbbb.aaaaaaa]
+    //      step 1:  [..hhhhhhhggggggg..ffffffeeeeeee..ddddddccccccc..bbbbbbbaaaaaaa]
+    //      ...
+    //      result:  [........hhhhhhhggggggg...............bbbbbbbaaaaaaa]
+    //
+    uint64_t CompactVarintBytes(uint64_t bytes)
+    {
+        bytes &= 0x7F7F7F7F7F7F7F7F;
+        bytes = ((bytes & 0x7F007F007F007F00) >> 1) | (bytes & 0x007F007F007F007F);
+        bytes = ((bytes & 0x3FFF00003FFF0000) >> 2) | (bytes & 0x00003FFF00003FFF);
+        bytes = ((bytes & 0x0FFFFFFF00000000) >> 4) | (bytes & 0x000000000FFFFFFF);
+        return bytes;
+    }
+
+    // Inverse of CompactVarintBytes, spreading the low 56 bits into 7-bit groups, one per byte.
+    uint64_t SpreadVarintBytes(uint64_t value)
+    {
+        value = ((value & 0x00FFFFFFF0000000) << 4) | (value & 0x000000000FFFFFFF);
+        value = ((value & 0x0FFFC0000FFFC000) << 2) | (value & 0x00003FFF00003FFF);
+        value = ((value & 0x3F803F803F803F80) << 1) | (value & 0x007F007F007F007F);
+        return value;
+    }
+
+    // Encodes a varint into bytes, returning the byte count (1-10).
+    uint32_t EncodeVarint(uint64_t value, /*out*/ uint8_t* bytes) // Must hold varintMaxByteCount bytes.
+    {
+        const uint32_t significantBitCount = 64 - std::countl_zero(value | 1);
+        const uint32_t byteCount = (significantBitCount + 6) / 7;
+        constexpr uint64_t continuationBits = 0x8080808080808080;
+        if (byteCount <= sizeof(uint64_t))
+        {
+            const uint64_t lowContinuationBits = continuationBits & ((uint64_t(1) << ((byteCount - 1) * CHAR_BIT)) - 1);
+            StoreUnalignedLe64(bytes, SpreadVarintBytes(value) | lowContinuationBits);
+        }
+        else
+        {
+            StoreUnalignedLe64(bytes, SpreadVarintBytes(value) | continuationBits);
+            const uint32_t highBits = static_cast<uint32_t>(value >> 56);
+            bytes[8] = static_cast<uint8_t>((highBits & 0x7F) | ((byteCount > 9) ? 0x80 : 0));
+            bytes[9] = static_cast<uint8_t>(highBits >> 7);
+        }
+        return byteCount;
+    }
+
+    // Returns the high bits of 16 bytes as a 16-bit mask (like SSE2's pmovmskb).
+    uint32_t GetHighBitMask16(uint8_t const* bytes)
+    {
+        #if BITSTRING_X64
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes))));
+        #else
+        // Multiplying gathers each byte's high bit into the top byte.
+        constexpr uint64_t highBits = 0x8080808080808080;
+        constexpr uint64_t gatheringMultiplier = 0x0002040810204081;
+        const uint64_t low = ((LoadUnalignedLe64(bytes) & highBits) * gatheringMultiplier) >> 56;
+        const uint64_t high = ((LoadUnalignedLe64(bytes + 8) & highBits) * gatheringMultiplier) >> 56;
+        return static_cast<uint32_t>(low | (high << 8));
+        #endif
+    }
+
+    // Zero extends 16 bytes into 16 values.
+    template <typename ValueType>
+    void WidenBytes16(uint8_t const* bytes, ValueType* values)
+    {
+        #if BITSTRING_X64
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bytes16 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes));
+        const __m128i words[2] = {_mm_unpacklo_epi8(bytes16, zero), _mm_unpackhi_epi8(bytes16, zero)};
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            const __m128i dwords = (i & 1) ? _mm_unpackhi_epi16(words[i >> 1], zero) : _mm_unpacklo_epi16(words[i >> 1], zero);
+            if constexpr (sizeof(ValueType) == sizeof(uint32_t))
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i * 4), dwords);
+            }
+            else
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i * 4), _mm_unpacklo_epi32(dwords, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i * 4 + 2), _mm_unpackhi_epi32(dwords, zero));
+            }
+        }
+        #else
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            values[i] = bytes[i];
+        }
+        #endif
+    }
+
+    // Decodes varints 16 bytes at a time, finding all varint boundaries within the 16 bytes from
+    // their high bits (in the spirit of masked VByte decoding, but decoding each varint with SWAR
+    // compaction rather than a 64KB table of shuffles). Runs of 1-byte varints, the most common case
+    // for small integers, are simply zero extended.
+    template <typename ValueType>
+    size_t ReadVarintArrayImpl(
+        std::span<uint8_t const> data,
+        /*inout*/ size_t& byteOffset,
+        std::span<ValueType> values
+    )
+    {
+        constexpr size_t chunkByteSize = 16;
+        uint8_t const* bytes = data.data();
+        const size_t dataByteSize = data.size_bytes();
+        const size_t valueCount = values.size();
+        size_t offset = byteOffset;
+        size_t valueIndex = 0;
+
+        // Each chunk decodes at most 16 varints, and loads 8 bytes from up to byte 15.
+        while (offset + chunkByteSize + sizeof(uint64_t) <= dataByteSize && valueIndex + chunkByteSize <= valueCount)
+        {
+            const uint32_t continuationMask = GetHighBitMask16(bytes + offset);
+            if (continuationMask == 0)
+            {
+                WidenBytes16(bytes + offset, values.data() + valueIndex);
+                offset += chunkByteSize;
+                valueIndex += chunkByteSize;
+                continue;
+            }
+
+            // Decode each varint ending within the chunk.
+            uint32_t terminatorMask = ~continuationMask & 0xFFFF;
+            uint32_t varintBegin = 0;
+            while (terminatorMask != 0)
+            {
+                const uint32_t varintEnd = std::countr_zero(terminatorMask) + 1;
+                const uint32_t varintByteCount = varintEnd - varintBegin;
+                if (varintByteCount > sizeof(uint64_t)) [[unlikely]]
+                {
+                    break; // Decoded below.
+                }
+                const uint64_t varintBytes = LoadUnalignedLe64(bytes + offset + varintBegin);
+                const uint64_t varintByteMask = ~uint64_t(0) >> (64 - varintByteCount * CHAR_BIT);
+                values[valueIndex++] = static_cast<ValueType>(CompactVarintBytes(varintBytes & varintByteMask));
+                varintBegin = varintEnd;
+                terminatorMask &= terminatorMask - 1;
+            }
+            offset += varintBegin;
+
+            // Varints longer than 8 bytes, including any spanning the whole chunk, decode singly.
+            if (terminatorMask != 0 || varintBegin == 0)
+            {
+                values[valueIndex++] = static_cast<ValueType>(ReadVarint(data, /*inout*/ offset));
+            }
+        }
+
+        while (valueIndex < valueCount && offset < dataByteSize)
+        {
+            values[valueIndex++] = static_cast<ValueType>(ReadVarint(data, /*inout*/ offset));
+        }
+
+        byteOffset = offset;
+        return valueIndex;
+    }
+
+    enum class SingleBitOperation
+    {
+        Set,
+        Clear,
+        Toggle,
+        Test,
+        TestAndSet,
+    };
+
+    // Applies the operation to a bit (known to be within data), returning its previous value.
+    template <SingleBitOperation operation, typename ByteType>
+    BITSTRING_FORCEINLINE bool ApplySingleBit(ByteType* bytes, size_t bitOffset, uint32_t bitIndexFlip)
+    {
+        const uint8_t bitMask = static_cast<uint8_t>(1u << ((bitOffset ^ bitIndexFlip) & 7));
+        ByteType& byte = bytes[bitOffset / CHAR_BIT];
+        const bool wasSet = (byte & bitMask) != 0;
+        if constexpr (operation == SingleBitOperation::Set || operation == SingleBitOperation::TestAndSet)
+        {
+            byte |= bitMask;
+        }
+        else if constexpr (operation == SingleBitOperation::Clear)
+        {
+            byte &= ~bitMask;
+        }
+        else if constexpr (operation == SingleBitOperation::Toggle)
+        {
+            byte ^= bitMask;
+        }
+        return wasSet;
+    }
+
+    // Applies the operation to every bit offset in order, optionally recording each bit's previous
+    // value, and returns the number of bits that were previously clear.
+    template <SingleBitOperation operation, typename ByteType>
+    size_t ApplySingleBits(
+        std::span<ByteType> data,
+        std::span<size_t const> bitOffsets,
+        bool reversedBitsInByte,
+        bool* wasSet // Optional, else bitOffsets.size().
+    )
+    {
+        const uint32_t bitIndexFlip = reversedBitsInByte ? CHAR_BIT - 1 : 0;
+        const size_t dataByteSize = data.size_bytes();
+        const size_t dataBitSize = dataByteSize * CHAR_BIT;
+        const size_t bitOffsetCount = bitOffsets.size();
+        size_t clearBitCount = 0;
+        size_t i = 0;
+
+        auto applySingleBit = [&](size_t index)
+        {
+            const size_t bitOffset = bitOffsets[index];
+            bool previousValue = false;
+            if (bitOffset < dataBitSize) [[likely]]
+            {
+                previousValue = ApplySingleBit<operation>(data.data(), bitOffset, bitIndexFlip);
+                clearBitCount += !previousValue;
+            }
+            if (wasSet != nullptr)
+            {
+                wasSet[index] = previousValue;
+            }
+        };
+
+        if (std::is_sorted(bitOffsets.begin(), bitOffsets.end()))
+        {
+            // Merge consecutive offsets within the same 64-bit word into a single load and store,
+            // where bit i of a word (loaded as LE) is bit i % 8 of byte i / 8.
+            const size_t wordCount = dataByteSize / sizeof(uint64_t);
+            while (i < bitOffsetCount && bitOffsets[i] / 64 < wordCount)
+            {
+                const size_t wordIndex = bitOffsets[i] / 64;
+                ByteType* wordData = data.data() + wordIndex * sizeof(uint64_t);
+                const uint64_t originalWord = LoadUnalignedLe64(wordData);
+                uint64_t word = originalWord;
+                do
+                {
+                    const uint64_t bitMask = uint64_t(1) << ((bitOffsets[i] ^ bitIndexFlip) & 63);
+                    const bool previousValue = (word & bitMask) != 0;
+                    if constexpr (operation == SingleBitOperation::Set || operation == SingleBitOperation::TestAndSet)
+                    {
+                        word |= bitMask;
+                    }
+                    else if constexpr (operation == SingleBitOperation::Clear)
+                    {
+                        word &= ~bitMask;
+                    }
+                    else if constexpr (operation == SingleBitOperation::Toggle)
+                    {
+                        word ^= bitMask;
+                    }
+                    clearBitCount += !previousValue;
+                    if (wasSet != nullptr)
+                    {
+                        wasSet[i] = previousValue;
+                    }
+                    ++i;
+                } while (i < bitOffsetCount && bitOffsets[i] / 64 == wordIndex);
+
+                if constexpr (!std::is_const_v<ByteType> && operation != SingleBitOperation::Test)
+                {
+                    if (word != originalWord)
+                    {
+                        StoreUnalignedLe64(wordData, word);
+                    }
+                }
+            }
+        }
+        else
+        {
+            // Prefetch the bytes of upcoming offsets far enough ahead to hide a cache miss,
+            // unrolled to keep several independent updates in flight.
+            constexpr size_t prefetchDistance = 16;
+            constexpr size_t unrollCount = 4;
+            auto prefetch = [&](size_t index)
+            {
+                const size_t byteOffset = std::min(bitOffsets[index] / CHAR_BIT, dataByteSize - 1);
+                BITSTRING_PREFETCH(data.data() + byteOffset);
+            };
+            if (dataByteSize > 0)
+            {
+                for (; i + prefetchDistance + unrollCount <= bitOffsetCount; i += unrollCount)
+                {
+                    prefetch(i + prefetchDistance + 0);
+                    prefetch(i + prefetchDistance + 1);
+                    prefetch(i + prefetchDistance + 2);
+                    prefetch(i + prefetchDistance + 3);
+                    applySingleBit(i + 0);
+                    applySingleBit(i + 1);
+                    applySingleBit(i + 2);
+                    applySingleBit(i + 3);
+                }
+            }
+        }
+
+        // Any remainder, or sorted offsets in the last partial word and beyond.
+        for (; i < bitOffsetCount; ++i)
+        {
+            applySingleBit(i);
+        }
+        return clearBitCount;
+    }
+
+    // Returns the mask of bits [beginBit, endBit) within a byte, in the given bit order.
+    uint8_t GetBitRangeByteMask(uint32_t beginBit, uint32_t endBit, bool reversedBitsInByte)
+    {
+        assert(beginBit < endBit && endBit <= CHAR_BIT);
+        return reversedBitsInByte
+            ? static_cast<uint8_t>((0xFF >> beginBit) & (0xFF << (CHAR_BIT - endBit)))
+            : static_cast<uint8_t>((0xFF << beginBit) & (0xFF >> (CHAR_BIT - endBit)));
+    }
+
+    // Either fills the range with the pattern, or if isFlip, XORs it with the pattern.
+    void ApplyBitRange(
+        std::span<uint8_t> data,
+        size_t bitOffset,
+        size_t bitCount,
+        bool reversedBitsInByte,
+        uint8_t pattern,
+        bool isFlip
+    )
+    {
+        const size_t dataBitSize = data.size_bytes() * CHAR_BIT;
+        if (bitOffset >= dataBitSize)
+        {
+            return;
+        }
+        bitCount = std::min(bitCount, dataBitSize - bitOffset);
+        if (bitCount == 0)
+        {
+            return;
+        }
+
+        auto applyMasked = [&](uint8_t& byte, uint8_t mask)
+        {
+            byte = isFlip ? byte ^ (pattern & mask) : (byte & ~mask) | (pattern & mask);
+        };
+
+        size_t byteOffset = bitOffset / CHAR_BIT;
+        const uint32_t beginBit = static_cast<uint32_t>(bitOffset & 7);
+        const size_t endBitOffset = bitOffset + bitCount;
+        const size_t endByteOffset = endBitOffset / CHAR_BIT; // Of the last partial byte, if any.
+
+        // Head byte, which may also be the tail byte if the range is within a single byte.
+        if (beginBit > 0 || byteOffset == endByteOffset)
+        {
+            const uint32_t endBit = (byteOffset == endByteOffset) ? static_cast<uint32_t>(endBitOffset & 7) : CHAR_BIT;
+            applyMasked(data[byteOffset], GetBitRangeByteMask(beginBit, endBit, reversedBitsInByte));
+            if (byteOffset == endByteOffset)
+            {
+                return;
+            }
+            ++byteOffset;
+        }
+
+        // Whole bytes.
+        uint8_t* bytes = data.data() + byteOffset;
+        const size_t byteCount = endByteOffset - byteOffset;
+        if (isFlip)
+        {
+            const uint64_t wordPattern = pattern * uint64_t(0x0101010101010101);
+            size_t i = 0;
+            for (; i + sizeof(uint64_t) <= byteCount; i += sizeof(uint64_t))
+            {
+                uint64_t word;
+                memcpy(&word, bytes + i, sizeof(word));
+                word ^= wordPattern;
+                memcpy(bytes + i, &word, sizeof(word));
+            }
+            for (; i < byteCount; ++i)
+            {
+                bytes[i] ^= pattern;
+            }
+        }
+        else
+        {
+            memset(bytes, pattern, byteCount);
+        }
+
+        // Tail byte.
+        const uint32_t endBit = static_cast<uint32_t>(endBitOffset & 7);
+        if (endBit > 0)
+        {
+            applyMasked(data[endByteOffset], GetBitRangeByteMask(0, endBit, reversedBitsInByte));
+        }
+    }
+
+    // Counts set bits 8 bytes at a time, with the popcnt instruction when compiled for it.
+    template <typename PopulationCountFunction>
+    BITSTRING_FORCEINLINE size_t CountBitsInBytesImpl(uint8_t const* bytes, size_t byteCount, PopulationCountFunction populationCount)
+    {
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= byteCount; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i, sizeof(word));
+            count += populationCount(word);
+        }
+        for (; i < byteCount; ++i)
+        {
+            count += std::popcount(bytes[i]);
+        }
+        return count;
+    }
+
+    #if BITSTRING_X64
+    // Only emits the popcnt instruction once inlined into a function targeting it, like
+    // CountBitsInBytesPopcnt.
+    BITSTRING_FORCEINLINE uint32_t PopulationCountPopcnt(uint64_t word)
+    {
+        #if defined(_MSC_VER) && !defined(__clang__)
+        return uint32_t(__popcnt64(word));
+        #else
+        return uint32_t(__builtin_popcountll(word));
+        #endif
+    }
+
+    BITSTRING_TARGET_POPCNT
+    size_t CountBitsInBytesPopcnt(uint8_t const* bytes, size_t byteCount)
+    {
+        return CountBitsInBytesImpl(bytes, byteCount, PopulationCountPopcnt);
+    }
+
+    // Per 64-bit lane counts of the set bits in each byte, looking up each nibble with pshufb and
+    // summing bytes with psadbw (Mula's method).
+    BITSTRING_TARGET_AVX2
+    BITSTRING_FORCEINLINE __m256i CountBits32Avx2(__m256i bytes)
+    {
+        const __m256i nibbleCounts = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+        );
+        const __m256i lowNibbleMask = _mm256_set1_epi8(0x0F);
+        const __m256i lowNibbles = _mm256_and_si256(bytes, lowNibbleMask);
+        const __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), lowNibbleMask);
+        const __m256i byteCounts = _mm256_add_epi8(
+            _mm256_shuffle_epi8(nibbleCounts, lowNibbles),
+            _mm256_shuffle_epi8(nibbleCounts, highNibbles)
+        );
+        return _mm256_sad_epu8(byteCounts, _mm256_setzero_si256());
+    }
+
+    // Carry-save adder, summing three bit vectors into a twos and a ones vector.
+    BITSTRING_TARGET_AVX2
+    BITSTRING_FORCEINLINE void CarrySaveAddAvx2(/*out*/ __m256i& high, /*out*/ __m256i& low, __m256i a, __m256i b, __m256i c)
+    {
+        const __m256i aXorB = _mm256_xor_si256(a, b);
+        high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(aXorB, c));
+        low = _mm256_xor_si256(aXorB, c);
+    }
+
+    // Counts set bits 512 bytes at a time using a Harley-Seal carry-save adder tree, so only one
+    // in 16 vectors is actually counted (the sixteens), and the partial ones/twos/fours/eights are
+    // counted once at the end. Returns the number of bytes processed (a multiple of 512).
+    BITSTRING_TARGET_AVX2
+    size_t CountBitsInBytesAvx2(uint8_t const* bytes, size_t byteCount, /*out*/ size_t& count)
+    {
+        constexpr size_t vectorsPerBlock = 16;
+        constexpr size_t blockByteSize = vectorsPerBlock * sizeof(__m256i);
+        const size_t blockCount = byteCount / blockByteSize;
+        __m256i const* vectors = reinterpret_cast<__m256i const*>(bytes);
+
+        __m256i total = _mm256_setzero_si256();
+        __m256i ones = _mm256_setzero_si256();
+        __m256i twos = _mm256_setzero_si256();
+        __m256i fours = _mm256_setzero_si256();
+        __m256i eights = _mm256_setzero_si256();
+        __m256i sixteens, twosA, twosB, foursA, foursB, eightsA, eightsB;
+
+        for (size_t block = 0; block < blockCount; ++block, vectors += vectorsPerBlock)
+        {
+            CarrySaveAddAvx2(/*out*/ twosA, /*out*/ ones, ones, _mm256_loadu_si256(vectors + 0), _mm256_loadu_si256(vectors + 1));
+            CarrySaveAddAvx2(/*out*/ twosB, /*out*/ ones, ones, _mm256_loadu_si256(vectors + 2), _mm256_loadu_si256(vectors + 3));
+            CarrySaveAddAvx2(/*out*/ foursA, /*out*/ twos, twos, twosA, twosB);
+            CarrySaveAddAvx2(/*out*/ twosA, /*out*/ ones, ones, _mm256_loadu_si256(vectors + 4), _mm256_loadu_si256(vectors + 5));
+            CarrySaveAddAvx2(/*out*/ twosB, /*out*/ ones, ones, _mm256_loadu_si256(vectors + 6), _mm256_loadu_si256(vectors + 7));
+            CarrySaveAddAvx2(/*out*/ foursB, /*out*/ twos, twos, twosA, twosB);
+            CarrySaveAddAvx2(/*out*/ eightsA, /*out*/ fours, fours, foursA, foursB);
+            CarrySaveAddAvx2(/*out*/ twosA, /*out*/ ones, ones, _mm256_loadu_si256(vectors + 8), _mm256_loadu_si256(vectors + 9));
+            CarrySaveAddAvx2(/*out*/ twosB, /*out*/ ones, ones, _mm256_loadu_si256(vectors + 10), _mm256_loadu_si256(vectors + 11));
+            CarrySaveAddAvx2(/*out*/ foursA, /*out*/ twos, twos, twosA, twosB);
+            CarrySaveAddAvx2(/*out*/ twosA, /*out*/ ones, ones, _mm256_loadu_si256(vectors + 12), _mm256_loadu_si256(vectors + 13));
+            CarrySaveAddAvx2(/*out*/ twosB, /*out*/ ones, ones, _mm256_loadu_si256(vectors + 14), _mm256_loadu_si256(vectors + 15));
+            CarrySaveAddAvx2(/*out*/ foursB, /*out*/ twos, twos, twosA, twosB);
+            CarrySaveAddAvx2(/*out*/ eightsB, /*out*/ fours, fours, foursA, foursB);
+            CarrySaveAddAvx2(/*out*/ sixteens, /*out*/ eights, eights, eightsA, eightsB);
+            total = _mm256_add_epi64(total, CountBits32Avx2(sixteens));
+        }
+
+        total = _mm256_slli_epi64(total, 4);
+        total = _mm256_add_epi64(total, _mm256_slli_epi64(CountBits32Avx2(eights), 3));
+        total = _mm256_add_epi64(total, _mm256_slli_epi64(CountBits32Avx2(fours), 2));
+        total = _mm256_add_epi64(total, _mm256_slli_epi64(CountBits32Avx2(twos), 1));
+        total = _mm256_add_epi64(total, CountBits32Avx2(ones));
+
+        alignas(32) uint64_t laneTotals[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneTotals), total);
+        count = size_t(laneTotals[0] + laneTotals[1] + laneTotals[2] + laneTotals[3]);
+        return blockCount * blockByteSize;
+    }
+    #endif
+
+    // Counts the set bits of whole bytes, with Harley-Seal on AVX2 for large counts, else popcnt.
+    // Shorter counts skip AVX2 entirely, since they would only pay for the final reductions.
+    size_t CountBitsInBytes(uint8_t const* bytes, size_t byteCount)
+    {
+        size_t count = 0;
+        #if BITSTRING_X64
+        constexpr size_t minimumAvx2ByteCount = 16 * sizeof(__m256i); // One Harley-Seal block.
+        if (byteCount >= minimumAvx2ByteCount && GetCpuFeatures().hasAvx2)
+        {
+            const size_t countedByteCount = CountBitsInBytesAvx2(bytes, byteCount, /*out*/ count);
+            bytes += countedByteCount;
+            byteCount -= countedByteCount;
+        }
+        if (GetCpuFeatures().hasPopcnt)
+        {
+            return count + CountBitsInBytesPopcnt(bytes, byteCount);
+        }
+        #endif
+        return count + CountBitsInBytesImpl(bytes, byteCount, [](uint64_t word) { return size_t(std::popcount(word)); });
+    }
+
+    // Returns the index of the first word at or after wordIndex (up to endWordIndex) that differs from
+    // emptyWord, comparing 8 words per iteration with AVX2, else 4, and the rest one by one.
+    #if BITSTRING_X64
+    BITSTRING_TARGET_AVX2
+    size_t SkipEmptyWordsForwardAvx2(uint8_t const* bytes, size_t wordIndex, size_t endWordIndex, uint64_t emptyWord)
+    {
+        const __m256i emptyVector = _mm256_set1_epi64x(static_cast<long long>(emptyWord));
+        for (; wordIndex + 8 <= endWordIndex; wordIndex += 8)
+        {
+            uint8_t const* chunk = bytes + wordIndex * sizeof(uint64_t);
+            const __m256i difference = _mm256_or_si256(
+                _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(chunk)), emptyVector),
+                _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(chunk + 32)), emptyVector)
+            );
+            if (!_mm256_testz_si256(difference, difference))
+            {
+                break;
+            }
+        }
+        return wordIndex;
+    }
+
+    // Same in reverse, returning the index after the last word before endWordIndex that differs.
+    BITSTRING_TARGET_AVX2
+    size_t SkipEmptyWordsBackwardAvx2(uint8_t const* bytes, size_t endWordIndex, uint64_t emptyWord)
+    {
+        const __m256i emptyVector = _mm256_set1_epi64x(static_cast<long long>(emptyWord));
+        for (; endWordIndex >= 8; endWordIndex -= 8)
+        {
+            uint8_t const* chunk = bytes + (endWordIndex - 8) * sizeof(uint64_t);
+            const __m256i difference = _mm256_or_si256(
+                _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(chunk)), emptyVector),
+                _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(chunk + 32)), emptyVector)
+            );
+            if (!_mm256_testz_si256(difference, difference))
+            {
+                break;
+            }
+        }
+        return endWordIndex;
+    }
+    #endif
+
+    size_t SkipEmptyWordsForward(uint8_t const* bytes, size_t wordIndex, size_t endWordIndex, uint64_t emptyWord)
+    {
+        #if BITSTRING_X64
+        if (GetCpuFeatures().hasAvx2)
+        {
+            wordIndex = SkipEmptyWordsForwardAvx2(bytes, wordIndex, endWordIndex, emptyWord);
+        }
+        #endif
+        for (; wordIndex + 4 <= endWordIndex; wordIndex += 4)
+        {
+            uint64_t words[4];
+            memcpy(words, bytes + wordIndex * sizeof(uint64_t), sizeof(words));
+            if (((words[0] ^ emptyWord) | (words[1] ^ emptyWord) | (words[2] ^ emptyWord) | (words[3] ^ emptyWord)) != 0)
+            {
+                break;
+            }
+        }
+        for (; wordIndex < endWordIndex; ++wordIndex)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + wordIndex * sizeof(uint64_t), sizeof(word));
+            if (word != emptyWord)
+            {
+                break;
+            }
+        }
+        return wordIndex;
+    }
+
+    size_t SkipEmptyWordsBackward(uint8_t const* bytes, size_t endWordIndex, uint64_t emptyWord)
+    {
+        #if BITSTRING_X64
+        if (GetCpuFeatures().hasAvx2)
+        {
+            endWordIndex = SkipEmptyWordsBackwardAvx2(bytes, endWordIndex, emptyWord);
+        }
+        #endif
+        for (; endWordIndex >= 4; endWordIndex -= 4)
+        {
+            uint64_t words[4];
+            memcpy(words, bytes + (endWordIndex - 4) * sizeof(uint64_t), sizeof(words));
+            if (((words[0] ^ emptyWord) | (words[1] ^ emptyWord) | (words[2] ^ emptyWord) | (words[3] ^ emptyWord)) != 0)
+            {
+                break;
+            }
+        }
+        for (; endWordIndex > 0; --endWordIndex)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + (endWordIndex - 1) * sizeof(uint64_t), sizeof(word));
+            if (word != emptyWord)
+            {
+                break;
+            }
+        }
+        return endWordIndex;
+    }
+
+    // Loads the word in bit order, inverted if searching for clear bits, with any bits past the end of
+    // data cleared so they are never found.
+    BITSTRING_FORCEINLINE uint64_t LoadSearchWord(std::span<uint8_t const> data, size_t wordIndex, bool reversedBitsInByte, uint64_t emptyWord)
+    {
+        uint64_t word = LoadBitOrderWord64(data, wordIndex, reversedBitsInByte) ^ emptyWord;
+        const size_t validBitCount = data.size_bytes() * CHAR_BIT - wordIndex * 64;
+        if (validBitCount < 64) [[unlikely]]
+        {
+            word &= reversedBitsInByte ? ~(~uint64_t(0) >> validBitCount) : ~(~uint64_t(0) << validBitCount);
+        }
+        return word;
+    }
+
+    // Searches for a set bit, or a clear bit when emptyWord is all ones (searching the inverted words).
+    size_t FindNextBit(std::span<uint8_t const> data, size_t bitOffset, bool reversedBitsInByte, uint64_t emptyWord)
+    {
+        const size_t dataByteSize = data.size_bytes();
+        if (bitOffset >= dataByteSize * CHAR_BIT)
+        {
+            return bitOffsetNotFound;
+        }
+
+        const size_t wordCount = (dataByteSize + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        const size_t wholeWordCount = dataByteSize / sizeof(uint64_t);
+        size_t wordIndex = bitOffset / 64;
+        const uint32_t bitInWord = static_cast<uint32_t>(bitOffset % 64);
+        uint64_t word = LoadSearchWord(data, wordIndex, reversedBitsInByte, emptyWord);
+        word &= reversedBitsInByte ? ~uint64_t(0) >> bitInWord : ~uint64_t(0) << bitInWord;
+        while (word == 0)
+        {
+            wordIndex = SkipEmptyWordsForward(data.data(), wordIndex + 1, wholeWordCount, emptyWord);
+            if (wordIndex >= wordCount)
+            {
+                return bitOffsetNotFound;
+            }
+            word = LoadSearchWord(data, wordIndex, reversedBitsInByte, emptyWord);
+        }
+        return wordIndex * 64 + (reversedBitsInByte ? std::countl_zero(word) : std::countr_zero(word));
+    }
+
+    size_t FindPrevBit(std::span<uint8_t const> data, size_t bitOffset, bool reversedBitsInByte, uint64_t emptyWord)
+    {
+        const size_t dataBitSize = data.size_bytes() * CHAR_BIT;
+        if (dataBitSize == 0)
+        {
+            return bitOffsetNotFound;
+        }
+        bitOffset = std::min(bitOffset, dataBitSize - 1);
+
+        size_t wordIndex = bitOffset / 64;
+        const uint32_t bitInWord = static_cast<uint32_t>(bitOffset % 64);
+        uint64_t word = LoadSearchWord(data, wordIndex, reversedBitsInByte, emptyWord);
+        word &= reversedBitsInByte ? ~uint64_t(0) << (63 - bitInWord) : ~uint64_t(0) >> (63 - bitInWord);
+        while (word == 0)
+        {
+            // Every word before the last is whole.
+            wordIndex = SkipEmptyWordsBackward(data.data(), wordIndex, emptyWord);
+            if (wordIndex == 0)
+            {
+                return bitOffsetNotFound;
+            }
+            --wordIndex;
+            word = LoadSearchWord(data, wordIndex, reversedBitsInByte, emptyWord);
+        }
+        return wordIndex * 64 + (reversedBitsInByte ? 63 - std::countr_zero(word) : 63 - std::countl_zero(word));
+    }
+
+    // Computes one destination byte of a shifted copy from two consecutive source bytes, where the
+    // destination byte starts at bit bitShift (1-7) of the first, like a funnel shift. For LE, later
+    // bits are higher in the byte, and for BE lower.
+    BITSTRING_FORCEINLINE uint8_t FunnelShiftByte(uint8_t byte, uint8_t nextByte, uint32_t bitShift, bool isBeData)
+    {
+        return isBeData
+            ? static_cast<uint8_t>((byte << bitShift) | (nextByte >> (CHAR_BIT - bitShift)))
+            : static_cast<uint8_t>((byte >> bitShift) | (nextByte << (CHAR_BIT - bitShift)));
+    }
+
+    // Same for 8 destination bytes, returned as a word in data order (LE or BE). Loading the 8 bytes
+    // in data order, the next source byte only supplies the last bitShift bits.
+    BITSTRING_FORCEINLINE uint64_t LoadFunnelShiftedWord(uint8_t const* source, uint32_t bitShift, bool isBeData)
+    {
+        if (isBeData)
+        {
+            const uint64_t word = LoadUnalignedBe64(source);
+            return (word << bitShift) | (source[sizeof(uint64_t)] >> (CHAR_BIT - bitShift));
+        }
+        else
+        {
+            const uint64_t word = LoadUnalignedLe64(source);
+            return (word >> bitShift) | (uint64_t(source[sizeof(uint64_t)]) << (64 - bitShift));
+        }
+    }
+
+    BITSTRING_FORCEINLINE void FunnelShiftWord(uint8_t* destination, uint8_t const* source, uint32_t bitShift, bool isBeData)
+    {
+        const uint64_t word = LoadFunnelShiftedWord(source, bitShift, isBeData);
+        isBeData ? StoreUnalignedBe64(destination, word) : StoreUnalignedLe64(destination, word);
+    }
+
+    #if BITSTRING_X64
+    // Same for 32 destination bytes, shifting each byte of one unaligned load and ORing in the
+    // remaining bits from each byte of a second load one byte later. There are no 8-bit shifts, so
+    // 16-bit shifts are masked to discard the bits crossing between bytes.
+    BITSTRING_TARGET_AVX2
+    BITSTRING_FORCEINLINE __m256i LoadFunnelShiftedBytes32Avx2(
+        uint8_t const* source,
+        __m128i bitShift,
+        __m128i complementBitShift,
+        __m256i byteMask, // Bits of each byte kept from the first load.
+        bool isBeData
+    )
+    {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source));
+        const __m256i nextBytes = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source + 1));
+        const __m256i shiftedBytes = isBeData ? _mm256_sll_epi16(bytes, bitShift) : _mm256_srl_epi16(bytes, bitShift);
+        const __m256i shiftedNextBytes = isBeData ? _mm256_srl_epi16(nextBytes, complementBitShift) : _mm256_sll_epi16(nextBytes, complementBitShift);
+        return _mm256_or_si256(
+            _mm256_and_si256(shiftedBytes, byteMask),
+            _mm256_andnot_si256(byteMask, shiftedNextBytes)
+        );
+    }
+
+    BITSTRING_TARGET_AVX2
+    BITSTRING_FORCEINLINE void FunnelShiftBytes32Avx2(
+        uint8_t* destination,
+        uint8_t const* source,
+        __m128i bitShift,
+        __m128i complementBitShift,
+        __m256i byteMask,
+        bool isBeData
+    )
+    {
+        const __m256i result = LoadFunnelShiftedBytes32Avx2(source, bitShift, complementBitShift, byteMask, isBeData);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), result);
+    }
+
+    // Copies byteCount shifted bytes 32 at a time, returning how many were copied (a multiple of 32),
+    // taken from the front if copying forward, or else from the back.
+    BITSTRING_TARGET_AVX2
+    size_t CopyShiftedBytesAvx2(uint8_t* destination, uint8_t const* source, size_t byteCount, uint32_t bitShift, bool isBeData, bool isBackward)
+    {
+        const __m128i bitShiftVector = _mm_cvtsi32_si128(int(bitShift));
+        const __m128i complementBitShiftVector = _mm_cvtsi32_si128(int(CHAR_BIT - bitShift));
+        const uint8_t keptBits = isBeData ? uint8_t(0xFF << bitShift) : uint8_t(0xFF >> bitShift);
+        const __m256i byteMask = _mm256_set1_epi8(static_cast<char>(keptBits));
+        const size_t chunkCount = byteCount / 32;
+        if (isBackward)
+        {
+            const size_t firstByteIndex = byteCount - chunkCount * 32;
+            for (size_t i = byteCount; i > firstByteIndex; )
+            {
+                i -= 32;
+                FunnelShiftBytes32Avx2(destination + i, source + i, bitShiftVector, complementBitShiftVector, byteMask, isBeData);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < chunkCount * 32; i += 32)
+            {
+                FunnelShiftBytes32Avx2(destination + i, source + i, bitShiftVector, complementBitShiftVector, byteMask, isBeData);
+            }
+        }
+        return chunkCount * 32;
+    }
+    #endif
+
+    // Copies byteCount whole destination bytes from the source bits starting at bit bitShift of
+    // source[0], reading through source[byteCount] if bitShift > 0. Handles overlap like memmove,
+    // given the copying direction, since every step loads its source bytes before storing, and
+    // never stores over source bytes of later steps.
+    void CopyShiftedBytes(uint8_t* destination, uint8_t const* source, size_t byteCount, uint32_t bitShift, bool isBeData, bool isBackward)
+    {
+        if (bitShift == 0)
+        {
+            memmove(destination, source, byteCount);
+            return;
+        }
+
+        size_t beginByteIndex = 0;
+        size_t endByteIndex = byteCount;
+        #if BITSTRING_X64
+        if (GetCpuFeatures().hasAvx2)
+        {
+            const size_t copiedByteCount = CopyShiftedBytesAvx2(destination, source, byteCount, bitShift, isBeData, isBackward);
+            if (isBackward)
+            {
+                endByteIndex -= copiedByteCount;
+            }
+            else
+            {
+                beginByteIndex += copiedByteCount;
+            }
+        }
+        #endif
+
+        if (isBackward)
+        {
+            for (; endByteIndex - beginByteIndex >= sizeof(uint64_t); endByteIndex -= sizeof(uint64_t))
+            {
+                FunnelShiftWord(destination + endByteIndex - sizeof(uint64_t), source + endByteIndex - sizeof(uint64_t), bitShift, isBeData);
+            }
+            for (; endByteIndex > beginByteIndex; --endByteIndex)
+            {
+                destination[endByteIndex - 1] = FunnelShiftByte(source[endByteIndex - 1], source[endByteIndex], bitShift, isBeData);
+            }
+        }
+        else
+        {
+            for (; endByteIndex - beginByteIndex >= sizeof(uint64_t); beginByteIndex += sizeof(uint64_t))
+            {
+                FunnelShiftWord(destination + beginByteIndex, source + beginByteIndex, bitShift, isBeData);
+            }
+            for (; beginByteIndex < endByteIndex; ++beginByteIndex)
+            {
+                destination[beginByteIndex] = FunnelShiftByte(source[beginByteIndex], source[beginByteIndex + 1], bitShift, isBeData);
+            }
+        }
+    }
+
+    template <BitOperation operation, typename T>
+    BITSTRING_FORCEINLINE T CombineValues(T a, T b)
+    {
+        if constexpr (operation == BitOperation::And)
+        {
+            return static_cast<T>(a & b);
+        }
+        else if constexpr (operation == BitOperation::Or)
+        {
+            return static_cast<T>(a | b);
+        }
+        else if constexpr (operation == BitOperation::Xor)
+        {
+            return static_cast<T>(a ^ b);
+        }
+        else
+        {
+            return static_cast<T>(a & ~b);
+        }
+    }
+
+    #if BITSTRING_X64
+    template <BitOperation operation>
+    BITSTRING_TARGET_AVX2
+    BITSTRING_FORCEINLINE __m256i CombineVectorsAvx2(__m256i a, __m256i b)
+    {
+        if constexpr (operation == BitOperation::And)
+        {
+            return _mm256_and_si256(a, b);
+        }
+        else if constexpr (operation == BitOperation::Or)
+        {
+            return _mm256_or_si256(a, b);
+        }
+        else if constexpr (operation == BitOperation::Xor)
+        {
+            return _mm256_xor_si256(a, b);
+        }
+        else
+        {
+            return _mm256_andnot_si256(b, a);
+        }
+    }
+
+    // Combines byteCount shifted bytes of each source 32 at a time, returning how many were combined
+    // (a multiple of 32). An unshifted source is loaded directly, since the funnel shift would read one
+    // byte past its last bit.
+    template <BitOperation operation>
+    BITSTRING_TARGET_AVX2
+    size_t CombineShiftedBytesAvx2(
+        uint8_t* destination,
+        uint8_t const* sourceA,
+        uint32_t bitShiftA,
+        uint8_t const* sourceB,
+        uint32_t bitShiftB,
+        size_t byteCount,
+        bool isBeData
+    )
+    {
+        auto getByteMask = [isBeData](uint32_t bitShift)
+        {
+            return static_cast<char>(isBeData ? uint8_t(0xFF << bitShift) : uint8_t(0xFF >> bitShift));
+        };
+        const __m128i bitShiftVectorA = _mm_cvtsi32_si128(int(bitShiftA));
+        const __m128i complementBitShiftVectorA = _mm_cvtsi32_si128(int(CHAR_BIT - bitShiftA));
+        const __m256i byteMaskA = _mm256_set1_epi8(getByteMask(bitShiftA));
+        const __m128i bitShiftVectorB = _mm_cvtsi32_si128(int(bitShiftB));
+        const __m128i complementBitShiftVectorB = _mm_cvtsi32_si128(int(CHAR_BIT - bitShiftB));
+        const __m256i byteMaskB = _mm256_set1_epi8(getByteMask(bitShiftB));
+
+        const size_t chunkByteCount = byteCount / 32 * 32;
+        for (size_t i = 0; i < chunkByteCount; i += 32)
+        {
+            const __m256i a = (bitShiftA == 0)
+                ? _mm256_loadu_si256(reinterpret_cast<__m256i const*>(sourceA + i))
+                : LoadFunnelShiftedBytes32Avx2(sourceA + i, bitShiftVectorA, complementBitShiftVectorA, byteMaskA, isBeData);
+            const __m256i b = (bitShiftB == 0)
+                ? _mm256_loadu_si256(reinterpret_cast<__m256i const*>(sourceB + i))
+                : LoadFunnelShiftedBytes32Avx2(sourceB + i, bitShiftVectorB, complementBitShiftVectorB, byteMaskB, isBeData);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), CombineVectorsAvx2<operation>(a, b));
+        }
+        return chunkByteCount;
+    }
+    #endif
+
+    // Combines byteCount whole destination bytes from the source bits starting at bit bitShiftA of
+    // sourceA[0] and bitShiftB of sourceB[0], like CopyShiftedBytes for two sources.
+    template <BitOperation operation>
+    void CombineShiftedBytes(
+        uint8_t* destination,
+        uint8_t const* sourceA,
+        uint32_t bitShiftA,
+        uint8_t const* sourceB,
+        uint32_t bitShiftB,
+        size_t byteCount,
+        bool isBeData
+    )
+    {
+        size_t i = 0;
+        #if BITSTRING_X64
+        if (GetCpuFeatures().hasAvx2)
+        {
+            i = CombineShiftedBytesAvx2<operation>(destination, sourceA, bitShiftA, sourceB, bitShiftB, byteCount, isBeData);
+        }
+        #endif
+
+        auto loadWord = [isBeData](uint8_t const* source, uint32_t bitShift) -> uint64_t
+        {
+            if (bitShift == 0)
+            {
+                return isBeData ? LoadUnalignedBe64(source) : LoadUnalignedLe64(source);
+            }
+            return LoadFunnelShiftedWord(source, bitShift, isBeData);
+        };
+        for (; i + sizeof(uint64_t) <= byteCount; i += sizeof(uint64_t))
+        {
+            const uint64_t word = CombineValues<operation>(loadWord(sourceA + i, bitShiftA), loadWord(sourceB + i, bitShiftB));
+            isBeData ? StoreUnalignedBe64(destination + i, word) : StoreUnalignedLe64(destination + i, word);
+        }
+
+        auto loadByte = [isBeData](uint8_t const* source, uint32_t bitShift) -> uint8_t
+        {
+            return (bitShift == 0) ? source[0] : FunnelShiftByte(source[0], source[1], bitShift, isBeData);
+        };
+        for (; i < byteCount; ++i)
+        {
+            destination[i] = CombineValues<operation>(loadByte(sourceA + i, bitShiftA), loadByte(sourceB + i, bitShiftB));
+        }
+    }
+
+    // Tables for PermuteNibbles that reverse the order of the 1-bit, 2-bit, or 4-bit groups within each
+    // byte (indexed by log2 of the group size), by reversing the bits of each nibble, swapping its
+    // 2-bit halves, or leaving it.
+    constexpr uint8_t nibblePermutationTables[3][16] = {
+        {0x0,0x8,0x4,0xC,0x2,0xA,0x6,0xE,0x1,0x9,0x5,0xD,0x3,0xB,0x7,0xF},
+        {0x0,0x4,0x8,0xC,0x1,0x5,0x9,0xD,0x2,0x6,0xA,0xE,0x3,0x7,0xB,0xF},
+        {0x0,0x1,0x2,0x3,0x4,0x5,0x6,0x7,0x8,0x9,0xA,0xB,0xC,0xD,0xE,0xF},
+    };
+    constexpr uint8_t const (&bitReversalNibbleTable)[16] = nibblePermutationTables[0];
+
+    // Permutes the bit groups within each byte by looking up each nibble in a 16-entry table, where
+    // the low nibble's entry becomes the high nibble and vice versa. e.g. a table reversing the bits
+    // of a nibble reverses the bits of the byte, and one swapping its 2-bit halves reverses the byte's
+    // 2-bit groups.
+    #if BITSTRING_X64
+    BITSTRING_TARGET_AVX2
+    size_t PermuteNibblesAvx2(uint8_t* destination, uint8_t const* source, size_t byteCount, uint8_t const (&nibbleTable)[16])
+    {
+        const __m256i lowNibbleMask = _mm256_set1_epi8(0x0F);
+        const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(nibbleTable)));
+        const __m256i shiftedTable = _mm256_slli_epi16(table, 4); // Entries never exceed 0x0F.
+        const size_t chunkByteCount = byteCount / 32 * 32;
+        for (size_t i = 0; i < chunkByteCount; i += 32)
+        {
+            const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source + i));
+            const __m256i lowNibbles = _mm256_and_si256(bytes, lowNibbleMask);
+            const __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), lowNibbleMask);
+            const __m256i result = _mm256_or_si256(
+                _mm256_shuffle_epi8(shiftedTable, lowNibbles),
+                _mm256_shuffle_epi8(table, highNibbles)
+            );
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), result);
+        }
+        return chunkByteCount;
+    }
+    #endif
+
+    void PermuteNibbles(uint8_t* destination, uint8_t const* source, size_t byteCount, uint8_t const (&nibbleTable)[16])
+    {
+        size_t i = 0;
+        #if BITSTRING_X64
+        if (GetCpuFeatures().hasAvx2)
+        {
+            i = PermuteNibblesAvx2(destination, source, byteCount, nibbleTable);
+        }
+        #endif
+        for (; i < byteCount; ++i)
+        {
+            const uint8_t byte = source[i];
+            destination[i] = static_cast<uint8_t>((nibbleTable[byte & 0x0F] << 4) | nibbleTable[byte >> 4]);
+        }
+    }
+
+    uint8_t ReverseBitsInByte(uint8_t byte)
+    {
+        return static_cast<uint8_t>((bitReversalNibbleTable[byte & 0x0F] << 4) | bitReversalNibbleTable[byte >> 4]);
+    }
+
+    // Reverses the order of all the bits of the bytes in place (reversing both the byte order and the
+    // bits within each byte), swapping 32-byte blocks from both ends until fewer than 64 bytes remain
+    // in the middle. Returns the byte count processed from each end.
+    #if BITSTRING_X64
+    BITSTRING_TARGET_AVX2
+    BITSTRING_FORCEINLINE __m256i ReverseBitOrder32Avx2(__m256i bytes, __m256i table, __m256i shiftedTable)
+    {
+        // Reversing the bytes within each lane, then swapping the lanes, reverses all 32 bytes.
+        const __m256i byteReversal = _mm256_setr_epi8(
+            15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+            15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+        );
+        const __m256i lowNibbleMask = _mm256_set1_epi8(0x0F);
+        bytes = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(bytes, byteReversal), 0x4E);
+        const __m256i lowNibbles = _mm256_and_si256(bytes, lowNibbleMask);
+        const __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), lowNibbleMask);
+        return _mm256_or_si256(_mm256_shuffle_epi8(shiftedTable, lowNibbles), _mm256_shuffle_epi8(table, highNibbles));
+    }
+
+    BITSTRING_TARGET_AVX2
+    size_t ReverseBitOrderAvx2(uint8_t* data, size_t byteCount)
+    {
+        const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(bitReversalNibbleTable)));
+        const __m256i shiftedTable = _mm256_slli_epi16(table, 4);
+        size_t i = 0;
+        for (; byteCount - 2 * i >= 64; i += 32)
+        {
+            __m256i* front = reinterpret_cast<__m256i*>(data + i);
+            __m256i* back = reinterpret_cast<__m256i*>(data + byteCount - i - 32);
+            const __m256i frontBytes = _mm256_loadu_si256(front);
+            const __m256i backBytes = _mm256_loadu_si256(back);
+            _mm256_storeu_si256(front, ReverseBitOrder32Avx2(backBytes, table, shiftedTable));
+            _mm256_storeu_si256(back, ReverseBitOrder32Avx2(frontBytes, table, shiftedTable));
+        }
+        return i;
+    }
+    #endif
+
+    void ReverseBitOrder(uint8_t* data, size_t byteCount)
+    {
+        size_t i = 0;
+        #if BITSTRING_X64
+        if (GetCpuFeatures().hasAvx2)
+        {
+            i = ReverseBitOrderAvx2(data, byteCount);
+        }
+        #endif
+        size_t j = byteCount - i;
+        for (; j - i >= 2; ++i)
+        {
+            --j;
+            const uint8_t frontByte = data[i];
+            data[i] = ReverseBitsInByte(data[j]);
+            data[j] = ReverseBitsInByte(frontByte);
+        }
+        if (j - i == 1)
+        {
+            data[i] = ReverseBitsInByte(data[i]);
+        }
+    }
+
+    // Reverses the bytes of each element of 2 or 4 bytes, 32 bytes at a time.
+    #if BITSTRING_X64
+    BITSTRING_TARGET_AVX2
+    size_t ReverseElementBytesAvx2(uint8_t* destination, uint8_t const* source, size_t byteCount, size_t elementByteSize)
+    {
+        const __m256i shuffle = (elementByteSize == 2)
+            ? _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+            : _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        const size_t chunkByteCount = byteCount / 32 * 32;
+        for (size_t i = 0; i < chunkByteCount; i += 32)
+        {
+            const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_shuffle_epi8(bytes, shuffle));
+        }
+        return chunkByteCount;
+    }
+    #endif
+
+    template <size_t elementByteSize>
+    void ReverseElementBytesScalar(uint8_t* destination, uint8_t const* source, size_t byteCount)
+    {
+        for (size_t i = 0; i < byteCount; i += elementByteSize)
+        {
+            uint8_t element[elementByteSize];
+            memcpy(element, source + i, elementByteSize);
+            for (size_t j = 0; j < elementByteSize; ++j)
+            {
+                destination[i + j] = element[elementByteSize - 1 - j];
+            }
+        }
+    }
+
+    void ReverseElementBytes(uint8_t* destination, uint8_t const* source, size_t elementByteSize, size_t elementCount)
+    {
+        const size_t byteCount = elementByteSize * elementCount;
+        if (elementByteSize == 1)
+        {
+            memmove(destination, source, byteCount);
+            return;
+        }
+
+        size_t i = 0;
+        #if BITSTRING_X64
+        if (GetCpuFeatures().hasAvx2 && (elementByteSize == 2 || elementByteSize == 4))
+        {
+            i = ReverseElementBytesAvx2(destination, source, byteCount, elementByteSize);
+        }
+        #endif
+        switch (elementByteSize)
+        {
+        case 2: ReverseElementBytesScalar<2>(destination + i, source + i, byteCount - i); break;
+        case 3: ReverseElementBytesScalar<3>(destination + i, source + i, byteCount - i); break;
+        case 4: ReverseElementBytesScalar<4>(destination + i, source + i, byteCount - i); break;
+        default: assert(false);
+        }
+    }
+
+    // Returns the bit index of the set bit with the given zero-based index within the word (which
+    // must have more set bits than setBitIndex), depositing a single bit at that set bit with pdep if
+    // fast, else counting whole bytes before clearing the lower set bits of the final byte.
+    uint32_t SelectBitInWord(uint64_t word, uint32_t setBitIndex)
+    {
+        assert(setBitIndex < uint32_t(std::popcount(word)));
+        #if BITSTRING_X64
+        if (GetCpuFeatures().hasFastBmi2)
+        {
+            uint64_t const value = uint64_t(1) << setBitIndex;
+            uint64_t result;
+            ScatterBitsArrayBmi2(&value, word, &result, 1);
+            return std::countr_zero(result);
+        }
+        #endif
+
+        uint32_t bitIndex = 0;
+        for (uint32_t byteSetBitCount; setBitIndex >= (byteSetBitCount = std::popcount(uint8_t(word >> bitIndex))); bitIndex += CHAR_BIT)
+        {
+            setBitIndex -= byteSetBitCount;
+        }
+        uint64_t remainingBits = word >> bitIndex;
+        for (; setBitIndex > 0; --setBitIndex)
+        {
+            remainingBits &= remainingBits - 1;
+        }
+        return bitIndex + std::countr_zero(remainingBits);
+    }
+
+    // Reverses the order of the low bitSize bits, for indexing Huffman tables of LSB-first streams.
+    uint32_t ReverseLowBits(uint32_t value, uint32_t bitSize)
+    {
+        uint32_t reversedValue = 0;
+        for (uint32_t i = 0; i < bitSize; ++i)
+        {
+            reversedValue = (reversedValue << 1) | ((value >> i) & 1);
+        }
+        return reversedValue;
+    }
+
+    // Fills every table entry whose index starts with the given code bits, where the remaining
+    // indexBitSize - codeBitSize index bits are don't-cares. Without reversal, the code occupies the
+    // high bits of the index, else the code is reversed into the low bits.
+    void FillHuffmanTableEntries(
+        std::span<HuffmanTableEntry> table,
+        uint32_t indexBitSize,
+        uint32_t code,
+        uint32_t codeBitSize,
+        bool reversedCodes,
+        HuffmanTableEntry entry
+    )
+    {
+        const uint32_t fillerBitSize = indexBitSize - codeBitSize;
+        const uint32_t fillerCount = 1u << fillerBitSize;
+        if (reversedCodes)
+        {
+            const uint32_t reversedCode = ReverseLowBits(code, codeBitSize);
+            for (uint32_t filler = 0; filler < fillerCount; ++filler)
+            {
+                table[reversedCode | (filler << codeBitSize)] = entry;
+            }
+        }
+        else
+        {
+            std::fill_n(table.begin() + (code << fillerBitSize), fillerCount, entry);
+        }
+    }
+}
+
 uint32_t ReadBitString(
     std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
     size_t bitOffset, // Must be within data.
@@ -115,10 +1803,292 @@ void WriteBitString(
     memcpy(data.data() + dataByteOffsetBegin, value.asBytes + endiannessAdjustment, elementByteSize);
 }
 
-void SetSingleBit(
-    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+uint64_t ReadBitString64(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
     size_t bitOffset,
-    bool reversedBitsInByte
+    size_t bitSize, // Must be <= 64
+    std::endian endianness
+)
+{
+    using LargestDataType = uint64_t;
+    const bool isBeData = (endianness == std::endian::big);
+
+    assert(bitSize <= sizeof(LargestDataType) * CHAR_BIT);
+    bitSize = std::min(bitSize, sizeof(LargestDataType) * CHAR_BIT);
+    if (bitSize == 0)
+    {
+        return 0;
+    }
+
+    // A 64-bit field at a misaligned offset spans up to 9 bytes, so stage the bytes as a two-part
+    // value: the first 8 bytes as a word, plus the 9th byte.
+    //
+    //      LE:     [9th byte][...........first word...........]    value = (staged >> bitPhase)
+    //      BE:     [...........first word...........][9th byte]    value = (staged << bitPhase) >> (64 - bitSize)
+    //
+    // When all 9 bytes are within data, they are loaded directly. Otherwise the in-range bytes are
+    // copied into zeroed staging memory, so any bits past the end of data read as 0.
+    const size_t dataByteSize = data.size_bytes();
+    const size_t dataByteOffsetBegin = std::min(bitOffset / CHAR_BIT, dataByteSize);
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    uint64_t firstWord;
+    uint8_t lastByte;
+
+    if (dataByteSize - dataByteOffsetBegin >= sizeof(uint64_t) + 1)
+    {
+        uint8_t const* bytes = data.data() + dataByteOffsetBegin;
+        firstWord = isBeData ? LoadUnalignedBe64(bytes) : LoadUnalignedLe64(bytes);
+        lastByte = bytes[sizeof(uint64_t)];
+    }
+    else
+    {
+        uint8_t stagingBytes[sizeof(uint64_t) * 2] = {};
+        const size_t dataByteOffsetEnd = std::min((bitOffset + bitSize + 7) / CHAR_BIT, dataByteSize);
+        if (dataByteOffsetEnd > dataByteOffsetBegin)
+        {
+            memcpy(stagingBytes, data.data() + dataByteOffsetBegin, dataByteOffsetEnd - dataByteOffsetBegin);
+        }
+        firstWord = isBeData ? LoadUnalignedBe64(stagingBytes) : LoadUnalignedLe64(stagingBytes);
+        lastByte = stagingBytes[sizeof(uint64_t)];
+    }
+
+    if (isBeData)
+    {
+        const uint64_t window = (bitPhase > 0) ? (firstWord << bitPhase) | (lastByte >> (CHAR_BIT - bitPhase)) : firstWord;
+        return window >> (64 - bitSize);
+    }
+    else
+    {
+        const uint64_t window = (bitPhase > 0) ? (firstWord >> bitPhase) | (uint64_t(lastByte) << (64 - bitPhase)) : firstWord;
+        return (bitSize < 64) ? window & ((uint64_t(1) << bitSize) - 1) : window;
+    }
+}
+
+void WriteBitString64(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitSize, // Must be <= 64
+    std::endian endianness,
+    uint64_t newValue
+)
+{
+    using LargestDataType = uint64_t;
+    const bool isBeData = (endianness == std::endian::big);
+
+    assert(bitSize <= sizeof(LargestDataType) * CHAR_BIT);
+    bitSize = std::min(bitSize, sizeof(LargestDataType) * CHAR_BIT);
+    if (bitSize == 0)
+    {
+        return;
+    }
+
+    // Stage the bytes like ReadBitString64 (first word + 9th byte), but only ever copy back the
+    // bytes overlapping the field, like WriteBitString.
+    const size_t dataByteSize = data.size_bytes();
+    const size_t dataByteOffsetBegin = std::min(bitOffset / CHAR_BIT, dataByteSize);
+    const size_t dataByteOffsetEnd = std::min((bitOffset + bitSize + 7) / CHAR_BIT, dataByteSize);
+    const size_t elementByteSize = dataByteOffsetEnd - dataByteOffsetBegin;
+    if (elementByteSize == 0)
+    {
+        return;
+    }
+
+    uint8_t stagingBytes[sizeof(uint64_t) * 2] = {};
+    memcpy(stagingBytes, data.data() + dataByteOffsetBegin, elementByteSize);
+    uint64_t firstWord = isBeData ? LoadUnalignedBe64(stagingBytes) : LoadUnalignedLe64(stagingBytes);
+    uint8_t lastByte = stagingBytes[sizeof(uint64_t)];
+
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    const uint64_t elementMask = (bitSize < 64) ? (uint64_t(1) << bitSize) - 1 : ~uint64_t(0);
+    newValue &= elementMask;
+
+    if (isBeData)
+    {
+        // Shift of the field's lowest bit relative to the 72-bit staged value's lowest bit.
+        const uint32_t shiftAmount = 72 - bitPhase - static_cast<uint32_t>(bitSize);
+        if (shiftAmount >= CHAR_BIT)
+        {
+            const uint32_t wordShiftAmount = shiftAmount - CHAR_BIT;
+            firstWord = (firstWord & ~(elementMask << wordShiftAmount)) | (newValue << wordShiftAmount);
+        }
+        else
+        {
+            const uint8_t lastByteMask = static_cast<uint8_t>(elementMask << shiftAmount);
+            lastByte = (lastByte & ~lastByteMask) | static_cast<uint8_t>(newValue << shiftAmount);
+            firstWord = (firstWord & ~(elementMask >> (CHAR_BIT - shiftAmount))) | (newValue >> (CHAR_BIT - shiftAmount));
+        }
+    }
+    else
+    {
+        firstWord = (firstWord & ~(elementMask << bitPhase)) | (newValue << bitPhase);
+        if (bitPhase > 0)
+        {
+            const uint8_t lastByteMask = static_cast<uint8_t>(elementMask >> (64 - bitPhase));
+            lastByte = (lastByte & ~lastByteMask) | static_cast<uint8_t>(newValue >> (64 - bitPhase));
+        }
+    }
+
+    isBeData ? StoreUnalignedBe64(stagingBytes, firstWord) : StoreUnalignedLe64(stagingBytes, firstWord);
+    stagingBytes[sizeof(uint64_t)] = lastByte;
+    memcpy(data.data() + dataByteOffsetBegin, stagingBytes, elementByteSize);
+}
+
+uint32_t ReadBitString(
+    PaddedSpan<uint8_t const> data,
+    size_t bitOffset, // Must be within data.
+    size_t bitSize, // Must be <= 32
+    std::endian endianness
+)
+{
+    using LargestDataType = uint32_t;
+    assert(bitSize <= sizeof(LargestDataType) * CHAR_BIT);
+    assert(bitOffset + bitSize <= data.size_bytes() * CHAR_BIT);
+    bitSize = std::min(bitSize, sizeof(LargestDataType) * CHAR_BIT);
+    if (bitSize == 0)
+    {
+        return 0;
+    }
+
+    // The padding guarantees all 8 bytes are readable, and a shift of at most 7 plus 32 bits fits.
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    const uint64_t elementMask = (uint64_t(1) << bitSize) - 1;
+    uint8_t const* wordData = data.data() + bitOffset / CHAR_BIT;
+    if (endianness == std::endian::big)
+    {
+        const uint32_t shiftAmount = 64 - static_cast<uint32_t>(bitSize) - bitPhase;
+        return static_cast<uint32_t>((LoadUnalignedBe64(wordData) >> shiftAmount) & elementMask);
+    }
+    else
+    {
+        return static_cast<uint32_t>((LoadUnalignedLe64(wordData) >> bitPhase) & elementMask);
+    }
+}
+
+void WriteBitString(
+    PaddedSpan<uint8_t> data,
+    size_t bitOffset, // Must be within data.
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    uint32_t newValue
+)
+{
+    using LargestDataType = uint32_t;
+    assert(bitSize <= sizeof(LargestDataType) * CHAR_BIT);
+    assert(bitOffset + bitSize <= data.size_bytes() * CHAR_BIT);
+    bitSize = std::min(bitSize, sizeof(LargestDataType) * CHAR_BIT);
+    if (bitSize == 0)
+    {
+        return;
+    }
+
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    const uint64_t elementMask = (uint64_t(1) << bitSize) - 1;
+    const uint64_t maskedValue = newValue & elementMask;
+    uint8_t* wordData = data.data() + bitOffset / CHAR_BIT;
+    if (endianness == std::endian::big)
+    {
+        const uint32_t shiftAmount = 64 - static_cast<uint32_t>(bitSize) - bitPhase;
+        const uint64_t word = LoadUnalignedBe64(wordData);
+        StoreUnalignedBe64(wordData, (word & ~(elementMask << shiftAmount)) | (maskedValue << shiftAmount));
+    }
+    else
+    {
+        const uint64_t word = LoadUnalignedLe64(wordData);
+        StoreUnalignedLe64(wordData, (word & ~(elementMask << bitPhase)) | (maskedValue << bitPhase));
+    }
+}
+
+uint64_t ReadBitString64(
+    PaddedSpan<uint8_t const> data,
+    size_t bitOffset, // Must be within data.
+    size_t bitSize, // Must be <= 64
+    std::endian endianness
+)
+{
+    using LargestDataType = uint64_t;
+    assert(bitSize <= sizeof(LargestDataType) * CHAR_BIT);
+    assert(bitOffset + bitSize <= data.size_bytes() * CHAR_BIT);
+    bitSize = std::min(bitSize, sizeof(LargestDataType) * CHAR_BIT);
+    if (bitSize == 0)
+    {
+        return 0;
+    }
+
+    // The 9th byte is at most 8 bytes past the last logical byte, so still within the padding.
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    uint8_t const* bytes = data.data() + bitOffset / CHAR_BIT;
+    const uint8_t lastByte = bytes[sizeof(uint64_t)];
+    if (endianness == std::endian::big)
+    {
+        const uint64_t firstWord = LoadUnalignedBe64(bytes);
+        const uint64_t window = (bitPhase > 0) ? (firstWord << bitPhase) | (lastByte >> (CHAR_BIT - bitPhase)) : firstWord;
+        return window >> (64 - bitSize);
+    }
+    else
+    {
+        const uint64_t firstWord = LoadUnalignedLe64(bytes);
+        const uint64_t window = (bitPhase > 0) ? (firstWord >> bitPhase) | (uint64_t(lastByte) << (64 - bitPhase)) : firstWord;
+        return (bitSize < 64) ? window & ((uint64_t(1) << bitSize) - 1) : window;
+    }
+}
+
+void WriteBitString64(
+    PaddedSpan<uint8_t> data,
+    size_t bitOffset, // Must be within data.
+    size_t bitSize, // Must be <= 64
+    std::endian endianness,
+    uint64_t newValue
+)
+{
+    using LargestDataType = uint64_t;
+    assert(bitSize <= sizeof(LargestDataType) * CHAR_BIT);
+    assert(bitOffset + bitSize <= data.size_bytes() * CHAR_BIT);
+    bitSize = std::min(bitSize, sizeof(LargestDataType) * CHAR_BIT);
+    if (bitSize == 0)
+    {
+        return;
+    }
+
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    const uint64_t elementMask = (bitSize < 64) ? (uint64_t(1) << bitSize) - 1 : ~uint64_t(0);
+    newValue &= elementMask;
+    uint8_t* bytes = data.data() + bitOffset / CHAR_BIT;
+    uint8_t& lastByte = bytes[sizeof(uint64_t)];
+
+    if (endianness == std::endian::big)
+    {
+        // Shift of the field's lowest bit relative to the 72-bit value's lowest bit (see WriteBitString64).
+        uint64_t firstWord = LoadUnalignedBe64(bytes);
+        const uint32_t shiftAmount = 72 - bitPhase - static_cast<uint32_t>(bitSize);
+        if (shiftAmount >= CHAR_BIT)
+        {
+            const uint32_t wordShiftAmount = shiftAmount - CHAR_BIT;
+            firstWord = (firstWord & ~(elementMask << wordShiftAmount)) | (newValue << wordShiftAmount);
+        }
+        else
+        {
+            const uint8_t lastByteMask = static_cast<uint8_t>(elementMask << shiftAmount);
+            lastByte = (lastByte & ~lastByteMask) | static_cast<uint8_t>(newValue << shiftAmount);
+            firstWord = (firstWord & ~(elementMask >> (CHAR_BIT - shiftAmount))) | (newValue >> (CHAR_BIT - shiftAmount));
+        }
+        StoreUnalignedBe64(bytes, firstWord);
+    }
+    else
+    {
+        const uint64_t firstWord = LoadUnalignedLe64(bytes);
+        StoreUnalignedLe64(bytes, (firstWord & ~(elementMask << bitPhase)) | (newValue << bitPhase));
+        if (bitPhase > 0)
+        {
+            const uint8_t lastByteMask = static_cast<uint8_t>(elementMask >> (64 - bitPhase));
+            lastByte = (lastByte & ~lastByteMask) | static_cast<uint8_t>(newValue >> (64 - bitPhase));
+        }
+    }
+}
+
+void SetSingleBit(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
 )
 {
     size_t byteOffset = bitOffset / CHAR_BIT;
@@ -130,3 +2100,1568 @@ void SetSingleBit(
         data[byteOffset] |= 1 << (bitOffset & byteMask);
     }
 }
+
+bool TestSingleBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+)
+{
+    if (bitOffset / CHAR_BIT >= data.size_bytes())
+    {
+        return false;
+    }
+    return ApplySingleBit<SingleBitOperation::Test>(data.data(), bitOffset, reversedBitsInByte ? CHAR_BIT - 1 : 0);
+}
+
+void ClearSingleBit(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+)
+{
+    assert(bitOffset / CHAR_BIT < data.size_bytes());
+    if (bitOffset / CHAR_BIT < data.size_bytes())
+    {
+        ApplySingleBit<SingleBitOperation::Clear>(data.data(), bitOffset, reversedBitsInByte ? CHAR_BIT - 1 : 0);
+    }
+}
+
+void ToggleSingleBit(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+)
+{
+    assert(bitOffset / CHAR_BIT < data.size_bytes());
+    if (bitOffset / CHAR_BIT < data.size_bytes())
+    {
+        ApplySingleBit<SingleBitOperation::Toggle>(data.data(), bitOffset, reversedBitsInByte ? CHAR_BIT - 1 : 0);
+    }
+}
+
+bool TestAndSetSingleBit(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+)
+{
+    assert(bitOffset / CHAR_BIT < data.size_bytes());
+    if (bitOffset / CHAR_BIT >= data.size_bytes())
+    {
+        return false;
+    }
+    return ApplySingleBit<SingleBitOperation::TestAndSet>(data.data(), bitOffset, reversedBitsInByte ? CHAR_BIT - 1 : 0);
+}
+
+void SetSingleBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte
+)
+{
+    ApplySingleBits<SingleBitOperation::Set>(data, bitOffsets, reversedBitsInByte, nullptr);
+}
+
+void ClearSingleBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte
+)
+{
+    ApplySingleBits<SingleBitOperation::Clear>(data, bitOffsets, reversedBitsInByte, nullptr);
+}
+
+void ToggleSingleBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte
+)
+{
+    ApplySingleBits<SingleBitOperation::Toggle>(data, bitOffsets, reversedBitsInByte, nullptr);
+}
+
+void TestSingleBits(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte,
+    std::span<bool> results // Must be the same size as bitOffsets.
+)
+{
+    assert(results.size() >= bitOffsets.size());
+    bitOffsets = bitOffsets.first(std::min(bitOffsets.size(), results.size()));
+    ApplySingleBits<SingleBitOperation::Test>(data, bitOffsets, reversedBitsInByte, results.data());
+}
+
+size_t TestAndSetSingleBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte,
+    std::span<bool> wasSet // Empty, or the same size as bitOffsets.
+)
+{
+    assert(wasSet.empty() || wasSet.size() >= bitOffsets.size());
+    if (!wasSet.empty())
+    {
+        bitOffsets = bitOffsets.first(std::min(bitOffsets.size(), wasSet.size()));
+    }
+    return ApplySingleBits<SingleBitOperation::TestAndSet>(data, bitOffsets, reversedBitsInByte, wasSet.empty() ? nullptr : wasSet.data());
+}
+
+void SetBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+)
+{
+    ApplyBitRange(data, bitOffset, bitCount, reversedBitsInByte, 0xFF, /*isFlip*/ false);
+}
+
+void ClearBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+)
+{
+    ApplyBitRange(data, bitOffset, bitCount, reversedBitsInByte, 0x00, /*isFlip*/ false);
+}
+
+void FlipBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+)
+{
+    ApplyBitRange(data, bitOffset, bitCount, reversedBitsInByte, 0xFF, /*isFlip*/ true);
+}
+
+void FillBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte,
+    uint8_t pattern
+)
+{
+    ApplyBitRange(data, bitOffset, bitCount, reversedBitsInByte, pattern, /*isFlip*/ false);
+}
+
+void ReverseBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+)
+{
+    const size_t dataBitSize = data.size_bytes() * CHAR_BIT;
+    if (bitOffset >= dataBitSize)
+    {
+        return;
+    }
+    bitCount = std::min(bitCount, dataBitSize - bitOffset);
+    if (bitCount < 2)
+    {
+        return;
+    }
+
+    // Reversing all the bits of the spanned bytes leaves the range reversed, but starting tailBitCount
+    // bits in rather than headBitCount, so shift it back and restore the bits outside the range.
+    const size_t beginByteOffset = bitOffset / CHAR_BIT;
+    const size_t endByteOffset = (bitOffset + bitCount + CHAR_BIT - 1) / CHAR_BIT;
+    const uint32_t headBitCount = bitOffset % CHAR_BIT;
+    const uint32_t tailBitCount = uint32_t(endByteOffset * CHAR_BIT - bitOffset - bitCount);
+    std::span<uint8_t> bytes = data.subspan(beginByteOffset, endByteOffset - beginByteOffset);
+    const uint8_t firstByte = bytes.front();
+    const uint8_t lastByte = bytes.back();
+
+    ReverseBitOrder(bytes.data(), bytes.size());
+    if (headBitCount != tailBitCount)
+    {
+        const std::endian endianness = reversedBitsInByte ? std::endian::big : std::endian::little;
+        ShiftBits(bytes, ptrdiff_t(tailBitCount) - ptrdiff_t(headBitCount), bytes.size() * CHAR_BIT, endianness);
+    }
+    if (headBitCount > 0)
+    {
+        const uint8_t mask = GetBitRangeByteMask(0, headBitCount, reversedBitsInByte);
+        bytes.front() = (bytes.front() & ~mask) | (firstByte & mask);
+    }
+    if (tailBitCount > 0)
+    {
+        const uint8_t mask = GetBitRangeByteMask(CHAR_BIT - tailBitCount, CHAR_BIT, reversedBitsInByte);
+        bytes.back() = (bytes.back() & ~mask) | (lastByte & mask);
+    }
+}
+
+size_t CountBits(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+)
+{
+    const size_t dataBitSize = data.size_bytes() * CHAR_BIT;
+    if (bitOffset >= dataBitSize)
+    {
+        return 0;
+    }
+    bitCount = std::min(bitCount, dataBitSize - bitOffset);
+    if (bitCount == 0)
+    {
+        return 0;
+    }
+
+    size_t byteOffset = bitOffset / CHAR_BIT;
+    const uint32_t beginBit = static_cast<uint32_t>(bitOffset & 7);
+    const size_t endBitOffset = bitOffset + bitCount;
+    const size_t endByteOffset = endBitOffset / CHAR_BIT; // Of the last partial byte, if any.
+    size_t count = 0;
+
+    // Head byte, which may also be the tail byte if the range is within a single byte.
+    if (beginBit > 0 || byteOffset == endByteOffset)
+    {
+        const uint32_t endBit = (byteOffset == endByteOffset) ? static_cast<uint32_t>(endBitOffset & 7) : CHAR_BIT;
+        count += std::popcount(uint8_t(data[byteOffset] & GetBitRangeByteMask(beginBit, endBit, reversedBitsInByte)));
+        if (byteOffset == endByteOffset)
+        {
+            return count;
+        }
+        ++byteOffset;
+    }
+
+    count += CountBitsInBytes(data.data() + byteOffset, endByteOffset - byteOffset);
+
+    // Tail byte.
+    const uint32_t endBit = static_cast<uint32_t>(endBitOffset & 7);
+    if (endBit > 0)
+    {
+        count += std::popcount(uint8_t(data[endByteOffset] & GetBitRangeByteMask(0, endBit, reversedBitsInByte)));
+    }
+    return count;
+}
+
+size_t FindNextSetBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+)
+{
+    return FindNextBit(data, bitOffset, reversedBitsInByte, /*emptyWord*/ 0);
+}
+
+size_t FindNextClearBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+)
+{
+    return FindNextBit(data, bitOffset, reversedBitsInByte, /*emptyWord*/ ~uint64_t(0));
+}
+
+size_t FindPrevSetBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+)
+{
+    return FindPrevBit(data, bitOffset, reversedBitsInByte, /*emptyWord*/ 0);
+}
+
+size_t FindPrevClearBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+)
+{
+    return FindPrevBit(data, bitOffset, reversedBitsInByte, /*emptyWord*/ ~uint64_t(0));
+}
+
+void ReadBitStringArray(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset, // Bit offset of the first element.
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    std::span<uint32_t> values // Receives values.size() elements.
+)
+{
+    using LargestDataType = uint32_t;
+    const bool isBeData = (endianness == std::endian::big);
+
+    assert(bitSize <= sizeof(LargestDataType) * CHAR_BIT);
+    bitSize = std::min(bitSize, sizeof(LargestDataType) * CHAR_BIT);
+
+    if (bitSize == 0)
+    {
+        std::fill(values.begin(), values.end(), 0);
+        return;
+    }
+
+    #if BITSTRING_X64
+    // Decode groups of 8 elements with AVX2 when available, regardless of bit alignment.
+    if (GetCpuFeatures().hasAvx2)
+    {
+        const size_t groupElementCount = ReadBitStringArrayAvx2(
+            data.data(),
+            data.size_bytes(),
+            bitOffset,
+            static_cast<uint32_t>(bitSize),
+            isBeData,
+            values.data(),
+            values.size()
+        );
+        values = values.subspan(groupElementCount);
+        bitOffset += groupElementCount * bitSize;
+    }
+    #endif
+
+    // Decode whole blocks of 32 elements with the width-specialized kernels when byte aligned.
+    const size_t blockCount = GetBitStringBlockCount(data.size_bytes(), bitOffset, bitSize, values.size());
+    if (blockCount > 0)
+    {
+        const UnpackBlockFunction unpackBlock = unpackBlockFunctions[isBeData][bitSize];
+        const size_t blockByteSize = bitSize * (bitStringBlockElementCount / CHAR_BIT);
+        uint8_t const* input = data.data() + bitOffset / CHAR_BIT;
+        uint32_t* output = values.data();
+        for (size_t i = 0; i < blockCount; ++i, input += blockByteSize, output += bitStringBlockElementCount)
+        {
+            unpackBlock(input, output);
+        }
+        const size_t blockElementCount = blockCount * bitStringBlockElementCount;
+        values = values.subspan(blockElementCount);
+        bitOffset += blockElementCount * bitSize;
+    }
+
+    const size_t elementCount = values.size();
+
+    // Any element whose 8-byte window starting at its first byte lies fully within data can be read
+    // with a single unaligned load, since a shift of at most 7 plus 32 bits fits within 64 bits.
+    // That avoids the per-element clamping, memcpy, and byte reversal of ReadBitString.
+    //
+    //      element i is fast if:   (bitOffset + i * bitSize) / 8 <= dataByteSize - 8
+    //                    i.e. if:  i <= ((dataByteSize - 8) * 8 + 7 - bitOffset) / bitSize
+    //
+    const size_t dataByteSize = data.size_bytes();
+    size_t fastElementCount = 0;
+    if (dataByteSize >= sizeof(uint64_t))
+    {
+        const size_t lastFastBitOffset = (dataByteSize - sizeof(uint64_t)) * CHAR_BIT + (CHAR_BIT - 1);
+        if (bitOffset <= lastFastBitOffset)
+        {
+            fastElementCount = std::min((lastFastBitOffset - bitOffset) / bitSize + 1, elementCount);
+        }
+    }
+
+    uint8_t const* bytes = data.data();
+    uint32_t* outputValues = values.data();
+    const uint32_t bitSize32Bit = static_cast<uint32_t>(bitSize);
+    const uint64_t elementMask = (uint64_t(1) << bitSize) - 1;
+    size_t elementBitOffset = bitOffset;
+
+    if (isBeData)
+    {
+        // The element's last bit lands at bit (64 - shift - bitSize) of the big endian word.
+        for (size_t i = 0; i < fastElementCount; ++i, elementBitOffset += bitSize)
+        {
+            const uint64_t word = LoadUnalignedBe64(bytes + elementBitOffset / CHAR_BIT);
+            const uint32_t shiftAmount = 64 - bitSize32Bit - static_cast<uint32_t>(elementBitOffset & 7);
+            outputValues[i] = static_cast<uint32_t>((word >> shiftAmount) & elementMask);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < fastElementCount; ++i, elementBitOffset += bitSize)
+        {
+            const uint64_t word = LoadUnalignedLe64(bytes + elementBitOffset / CHAR_BIT);
+            const uint32_t shiftAmount = static_cast<uint32_t>(elementBitOffset & 7);
+            outputValues[i] = static_cast<uint32_t>((word >> shiftAmount) & elementMask);
+        }
+    }
+
+    // Read any trailing elements near the end of the data (including those partially or fully outside it).
+    for (size_t i = fastElementCount; i < elementCount; ++i, elementBitOffset += bitSize)
+    {
+        outputValues[i] = ReadBitString(data, elementBitOffset, bitSize, endianness);
+    }
+}
+
+void WriteBitStringArray(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset, // Bit offset of the first element.
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    std::span<uint32_t const> values
+)
+{
+    using LargestDataType = uint32_t;
+    const bool isBeData = (endianness == std::endian::big);
+
+    assert(bitSize <= sizeof(LargestDataType) * CHAR_BIT);
+    bitSize = std::min(bitSize, sizeof(LargestDataType) * CHAR_BIT);
+
+    if (bitSize == 0 || values.empty())
+    {
+        return;
+    }
+
+    // Encode whole blocks of 32 elements with the width-specialized kernels when byte aligned.
+    const size_t blockCount = GetBitStringBlockCount(data.size_bytes(), bitOffset, bitSize, values.size());
+    if (blockCount > 0)
+    {
+        const PackBlockFunction packBlock = packBlockFunctions[isBeData][bitSize];
+        const size_t blockByteSize = bitSize * (bitStringBlockElementCount / CHAR_BIT);
+        uint32_t const* input = values.data();
+        uint8_t* output = data.data() + bitOffset / CHAR_BIT;
+        for (size_t i = 0; i < blockCount; ++i, input += bitStringBlockElementCount, output += blockByteSize)
+        {
+            packBlock(input, output);
+        }
+        const size_t blockElementCount = blockCount * bitStringBlockElementCount;
+        values = values.subspan(blockElementCount);
+        bitOffset += blockElementCount * bitSize;
+    }
+
+    const size_t elementCount = values.size();
+
+    // Elements that lie fully within data are streamed through a bit accumulator, with only the
+    // leading and trailing partial bytes merged with the existing data. Full 32-bit words are
+    // stored directly without reading back the old contents.
+    //
+    // LE data fills the accumulator from the low bits upward, with the oldest bits stored first:
+    //
+    //      accumulator:    [...unused...|newest value|...|oldest value|existing head bits]
+    //
+    // BE data shifts each value in from the bottom, with the oldest bits at the top:
+    //
+    //      accumulator:    [...stored...|existing head bits|oldest value|...|newest value]
+    //
+    const size_t dataBitSize = data.size_bytes() * CHAR_BIT;
+    size_t fastElementCount = 0;
+    if (bitOffset < dataBitSize)
+    {
+        fastElementCount = std::min((dataBitSize - bitOffset) / bitSize, elementCount);
+    }
+
+    if (fastElementCount > 0)
+    {
+        uint8_t* bytes = data.data() + bitOffset / CHAR_BIT;
+        uint32_t const* inputValues = values.data();
+        const uint32_t bitSize32Bit = static_cast<uint32_t>(bitSize);
+        const uint32_t valueMask = static_cast<uint32_t>((uint64_t(1) << bitSize) - 1);
+        const uint32_t headBitCount = static_cast<uint32_t>(bitOffset & 7);
+        uint32_t accumulatedBitCount = headBitCount;
+        uint64_t accumulator;
+
+        if (isBeData)
+        {
+            accumulator = (headBitCount > 0) ? (bytes[0] >> (CHAR_BIT - headBitCount)) : 0;
+            for (size_t i = 0; i < fastElementCount; ++i)
+            {
+                accumulator = (accumulator << bitSize32Bit) | (inputValues[i] & valueMask);
+                accumulatedBitCount += bitSize32Bit;
+                if (accumulatedBitCount >= 32)
+                {
+                    accumulatedBitCount -= 32;
+                    StoreUnalignedBe32(bytes, static_cast<uint32_t>(accumulator >> accumulatedBitCount));
+                    bytes += sizeof(uint32_t);
+                }
+            }
+            for (; accumulatedBitCount >= CHAR_BIT; ++bytes)
+            {
+                accumulatedBitCount -= CHAR_BIT;
+                *bytes = static_cast<uint8_t>(accumulator >> accumulatedBitCount);
+            }
+            if (accumulatedBitCount > 0)
+            {
+                const uint8_t keptBitsMask = static_cast<uint8_t>((1u << (CHAR_BIT - accumulatedBitCount)) - 1);
+                *bytes = (*bytes & keptBitsMask) | static_cast<uint8_t>(accumulator << (CHAR_BIT - accumulatedBitCount));
+            }
+        }
+        else
+        {
+            accumulator = bytes[0] & ((1u << headBitCount) - 1);
+            for (size_t i = 0; i < fastElementCount; ++i)
+            {
+                accumulator |= uint64_t(inputValues[i] & valueMask) << accumulatedBitCount;
+                accumulatedBitCount += bitSize32Bit;
+                if (accumulatedBitCount >= 32)
+                {
+                    StoreUnalignedLe32(bytes, static_cast<uint32_t>(accumulator));
+                    bytes += sizeof(uint32_t);
+                    accumulator >>= 32;
+                    accumulatedBitCount -= 32;
+                }
+            }
+            for (; accumulatedBitCount >= CHAR_BIT; ++bytes)
+            {
+                *bytes = static_cast<uint8_t>(accumulator);
+                accumulator >>= CHAR_BIT;
+                accumulatedBitCount -= CHAR_BIT;
+            }
+            if (accumulatedBitCount > 0)
+            {
+                const uint8_t keptBitsMask = static_cast<uint8_t>(~((1u << accumulatedBitCount) - 1));
+                *bytes = (*bytes & keptBitsMask) | static_cast<uint8_t>(accumulator);
+            }
+        }
+    }
+
+    // Write any trailing elements partially or fully outside the data (which discards them).
+    for (size_t i = fastElementCount; i < elementCount; ++i)
+    {
+        WriteBitString(data, bitOffset + i * bitSize, bitSize, endianness, values[i]);
+    }
+}
+
+void ConvertBitStringEndianness(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    std::span<uint8_t const> source,
+    size_t bitSize, // Must be <= 32
+    size_t elementCount,
+    std::endian sourceEndianness,
+    std::endian destinationEndianness
+)
+{
+    assert(bitSize <= 32);
+    bitSize = std::min<size_t>(bitSize, 32);
+    if (bitSize == 0)
+    {
+        return;
+    }
+    elementCount = std::min({elementCount, source.size_bytes() * CHAR_BIT / bitSize, destination.size_bytes() * CHAR_BIT / bitSize});
+    if (elementCount == 0)
+    {
+        return;
+    }
+    if (sourceEndianness == destinationEndianness)
+    {
+        CopyBits(destination, 0, source, 0, elementCount * bitSize, sourceEndianness);
+        return;
+    }
+
+    // Elements that fill whole bytes, or fit evenly within bytes, only move bytes or bit groups within
+    // bytes. The remaining elements of a final partial byte go through the general path.
+    if (bitSize % CHAR_BIT == 0)
+    {
+        ReverseElementBytes(destination.data(), source.data(), bitSize / CHAR_BIT, elementCount);
+        return;
+    }
+    size_t convertedElementCount = 0;
+    if (CHAR_BIT % bitSize == 0)
+    {
+        const size_t elementsPerByte = CHAR_BIT / bitSize;
+        const size_t byteCount = elementCount / elementsPerByte;
+        PermuteNibbles(destination.data(), source.data(), byteCount, nibblePermutationTables[std::countr_zero(bitSize)]);
+        convertedElementCount = byteCount * elementsPerByte;
+    }
+
+    // Unpack and repack chunks of elements spanning whole bytes (so converting in place never
+    // overwrites bits of elements not yet read), using the width-specialized block kernels.
+    constexpr size_t chunkElementCount = 256;
+    uint32_t values[chunkElementCount];
+    while (convertedElementCount < elementCount)
+    {
+        const size_t chunkBitOffset = convertedElementCount * bitSize;
+        const std::span<uint32_t> chunkValues(values, std::min(chunkElementCount, elementCount - convertedElementCount));
+        ReadBitStringArray(source, chunkBitOffset, bitSize, sourceEndianness, chunkValues);
+        WriteBitStringArray(destination, chunkBitOffset, bitSize, destinationEndianness, chunkValues);
+        convertedElementCount += chunkValues.size();
+    }
+}
+
+void ReverseBitsInBytes(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    std::span<uint8_t const> source
+)
+{
+    PermuteNibbles(destination.data(), source.data(), std::min(destination.size_bytes(), source.size_bytes()), bitReversalNibbleTable);
+}
+
+void ReverseBitsInBytes(
+    std::span<uint8_t> data // Size limited to 500GB's on 32-bit systems.
+)
+{
+    ReverseBitsInBytes(data, data);
+}
+
+uint64_t GatherBits(uint64_t value, uint64_t fieldMask)
+{
+    #if BITSTRING_X64
+    if (GetCpuFeatures().hasFastBmi2)
+    {
+        uint64_t result;
+        GatherBitsArrayBmi2(&value, fieldMask, &result, 1);
+        return result;
+    }
+    #endif
+    return GatherBitsPortable(value, fieldMask);
+}
+
+uint64_t ScatterBits(uint64_t value, uint64_t fieldMask)
+{
+    #if BITSTRING_X64
+    if (GetCpuFeatures().hasFastBmi2)
+    {
+        uint64_t result;
+        ScatterBitsArrayBmi2(&value, fieldMask, &result, 1);
+        return result;
+    }
+    #endif
+    return ScatterBitsPortable(value, fieldMask);
+}
+
+void GatherBitsArray(
+    std::span<uint64_t const> values,
+    uint64_t fieldMask,
+    std::span<uint64_t> results // Must be the same size as values.
+)
+{
+    assert(results.size() >= values.size());
+    const size_t count = std::min(values.size(), results.size());
+
+    #if BITSTRING_X64
+    if (GetCpuFeatures().hasFastBmi2)
+    {
+        GatherBitsArrayBmi2(values.data(), fieldMask, results.data(), count);
+        return;
+    }
+    #endif
+    for (size_t i = 0; i < count; ++i)
+    {
+        results[i] = GatherBitsPortable(values[i], fieldMask);
+    }
+}
+
+void ScatterBitsArray(
+    std::span<uint64_t const> values,
+    uint64_t fieldMask,
+    std::span<uint64_t> results // Must be the same size as values.
+)
+{
+    assert(results.size() >= values.size());
+    const size_t count = std::min(values.size(), results.size());
+
+    #if BITSTRING_X64
+    if (GetCpuFeatures().hasFastBmi2)
+    {
+        ScatterBitsArrayBmi2(values.data(), fieldMask, results.data(), count);
+        return;
+    }
+    #endif
+    for (size_t i = 0; i < count; ++i)
+    {
+        results[i] = ScatterBitsPortable(values[i], fieldMask);
+    }
+}
+
+uint32_t ReadBitFields(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    uint32_t fieldMask
+)
+{
+    return static_cast<uint32_t>(GatherBits(ReadBitString(data, bitOffset, bitSize, endianness), fieldMask));
+}
+
+void WriteBitFields(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    uint32_t fieldMask,
+    uint32_t newFieldValues
+)
+{
+    // Ignore mask bits beyond the window, since WriteBitString does not mask newValue itself.
+    fieldMask &= static_cast<uint32_t>((uint64_t(1) << std::min<size_t>(bitSize, 32)) - 1);
+    const uint32_t oldValue = ReadBitString(data, bitOffset, bitSize, endianness);
+    const uint32_t newValue = (oldValue & ~fieldMask) | static_cast<uint32_t>(ScatterBits(newFieldValues, fieldMask));
+    WriteBitString(data, bitOffset, bitSize, endianness, newValue);
+}
+
+bool BuildHuffmanTable(
+    std::span<uint16_t const> codeCounts, // Number of codes of each bit size, [0] = 1 bit ... [15] = 16 bits (like JPEG's BITS list).
+    std::span<uint16_t const> symbols, // Symbols in canonical code order (like JPEG's HUFFVAL list).
+    bool reversedCodes,
+    /*inout*/ uint32_t& rootBitSize, // Must be 1 to 16.
+    /*out*/ std::vector<HuffmanTableEntry>& table
+)
+{
+    table.clear();
+    if (codeCounts.size() > huffmanMaxCodeBitSize || rootBitSize == 0 || rootBitSize > huffmanMaxCodeBitSize)
+    {
+        return false;
+    }
+
+    // Check the code space is not over-subscribed (Kraft inequality), counting the codes.
+    int32_t unusedCodeCount = 1;
+    size_t codeCount = 0;
+    uint32_t maxCodeBitSize = 0;
+    for (uint32_t i = 0; i < codeCounts.size(); ++i)
+    {
+        unusedCodeCount = unusedCodeCount * 2 - codeCounts[i];
+        if (unusedCodeCount < 0)
+        {
+            return false;
+        }
+        codeCount += codeCounts[i];
+        maxCodeBitSize = (codeCounts[i] > 0) ? i + 1 : maxCodeBitSize;
+    }
+    if (codeCount != symbols.size())
+    {
+        return false;
+    }
+
+    rootBitSize = std::min(rootBitSize, std::max(maxCodeBitSize, 1u));
+    constexpr HuffmanTableEntry invalidEntry = {huffmanInvalidSymbol, 0, 0};
+    table.assign(size_t(1) << rootBitSize, invalidEntry);
+
+    // Assign the canonical codes: consecutive within a bit size, doubling upon each longer size.
+    std::vector<uint32_t> codes(codeCount);
+    std::vector<uint8_t> codeBitSizes(codeCount);
+    for (uint32_t code = 0, codeBitSize = 1, codeIndex = 0; codeBitSize <= maxCodeBitSize; ++codeBitSize, code <<= 1)
+    {
+        for (uint32_t i = 0; i < codeCounts[codeBitSize - 1]; ++i, ++code, ++codeIndex)
+        {
+            codes[codeIndex] = code;
+            codeBitSizes[codeIndex] = static_cast<uint8_t>(codeBitSize);
+        }
+    }
+
+    // Fill each short code's root entries directly, and long codes into subtables. Codes sharing a
+    // root prefix are consecutive, so each subtable is allocated upon reaching the first code of a
+    // new prefix, sized for the longest code of that prefix (the last one, since bit sizes increase).
+    uint32_t subtablePrefix = UINT32_MAX;
+    uint32_t subtableOffset = 0;
+    uint32_t subtableBitSize = 0;
+    for (size_t codeIndex = 0; codeIndex < codeCount; ++codeIndex)
+    {
+        const uint32_t code = codes[codeIndex];
+        const uint32_t codeBitSize = codeBitSizes[codeIndex];
+        const HuffmanTableEntry entry = {symbols[codeIndex], static_cast<uint8_t>(codeBitSize), 0};
+        if (codeBitSize <= rootBitSize)
+        {
+            FillHuffmanTableEntries(table, rootBitSize, code, codeBitSize, reversedCodes, entry);
+            continue;
+        }
+
+        const uint32_t suffixBitSize = codeBitSize - rootBitSize;
+        const uint32_t prefix = code >> suffixBitSize;
+        if (prefix != subtablePrefix)
+        {
+            size_t lastCodeIndex = codeIndex;
+            while (lastCodeIndex + 1 < codeCount
+                && (codes[lastCodeIndex + 1] >> (codeBitSizes[lastCodeIndex + 1] - rootBitSize)) == prefix)
+            {
+                ++lastCodeIndex;
+            }
+
+            subtablePrefix = prefix;
+            subtableBitSize = codeBitSizes[lastCodeIndex] - rootBitSize;
+            subtableOffset = static_cast<uint32_t>(table.size());
+            table.resize(table.size() + (size_t(1) << subtableBitSize), invalidEntry);
+            const HuffmanTableEntry linkEntry = {subtableOffset, static_cast<uint8_t>(rootBitSize), static_cast<uint8_t>(subtableBitSize)};
+            FillHuffmanTableEntries(table, rootBitSize, prefix, rootBitSize, reversedCodes, linkEntry);
+        }
+
+        FillHuffmanTableEntries(
+            std::span(table).subspan(subtableOffset, size_t(1) << subtableBitSize),
+            subtableBitSize,
+            code & ((1u << suffixBitSize) - 1),
+            suffixBitSize,
+            reversedCodes,
+            entry
+        );
+    }
+
+    return true;
+}
+
+bool BuildHuffmanTable(
+    std::span<uint8_t const> codeBitSizes, // Indexed by symbol, each <= huffmanMaxCodeBitSize.
+    bool reversedCodes,
+    /*inout*/ uint32_t& rootBitSize, // Must be 1 to 16.
+    /*out*/ std::vector<HuffmanTableEntry>& table
+)
+{
+    // Sort the used symbols by code bit size (stable, so by symbol within a bit size).
+    std::array<uint16_t, huffmanMaxCodeBitSize> codeCounts = {};
+    std::array<uint32_t, huffmanMaxCodeBitSize + 1> symbolOffsets = {};
+    if (codeBitSizes.size() > UINT16_MAX)
+    {
+        table.clear();
+        return false;
+    }
+    for (uint8_t codeBitSize : codeBitSizes)
+    {
+        if (codeBitSize > huffmanMaxCodeBitSize)
+        {
+            table.clear();
+            return false;
+        }
+        if (codeBitSize > 0)
+        {
+            ++codeCounts[codeBitSize - 1];
+        }
+    }
+    for (uint32_t i = 0; i < huffmanMaxCodeBitSize; ++i)
+    {
+        symbolOffsets[i + 1] = symbolOffsets[i] + codeCounts[i];
+    }
+
+    std::vector<uint16_t> sortedSymbols(symbolOffsets.back());
+    for (size_t symbol = 0; symbol < codeBitSizes.size(); ++symbol)
+    {
+        const uint8_t codeBitSize = codeBitSizes[symbol];
+        if (codeBitSize > 0)
+        {
+            sortedSymbols[symbolOffsets[codeBitSize - 1]++] = static_cast<uint16_t>(symbol);
+        }
+    }
+
+    return BuildHuffmanTable(codeCounts, sortedSymbols, reversedCodes, /*inout*/ rootBitSize, /*out*/ table);
+}
+
+uint64_t ReadVarint(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& byteOffset
+)
+{
+    const size_t dataByteSize = data.size_bytes();
+    if (byteOffset < dataByteSize && dataByteSize - byteOffset >= sizeof(uint64_t)) [[likely]]
+    {
+        // Find the first byte without a continuation bit, then keep the bytes up to it.
+        const uint64_t bytes = LoadUnalignedLe64(data.data() + byteOffset);
+        const uint64_t terminatorBits = ~bytes & 0x8080808080808080;
+        if (terminatorBits != 0) [[likely]]
+        {
+            byteOffset += std::countr_zero(terminatorBits) / CHAR_BIT + 1;
+            return CompactVarintBytes(bytes & (terminatorBits ^ (terminatorBits - 1)));
+        }
+    }
+
+    // Long varints and those near the end of data, one byte at a time.
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < varintMaxByteCount && byteOffset < dataByteSize; ++i)
+    {
+        const uint8_t byte = data[byteOffset++];
+        value |= uint64_t(byte & 0x7F) << (i * 7);
+        if (!(byte & 0x80))
+        {
+            break;
+        }
+    }
+    return value;
+}
+
+void WriteVarint(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& byteOffset,
+    uint64_t value
+)
+{
+    uint8_t bytes[varintMaxByteCount];
+    const uint32_t byteCount = EncodeVarint(value, /*out*/ bytes);
+    const size_t dataByteSize = data.size_bytes();
+    if (byteOffset < dataByteSize)
+    {
+        memcpy(data.data() + byteOffset, bytes, std::min(size_t(byteCount), dataByteSize - byteOffset));
+    }
+    byteOffset += byteCount;
+}
+
+uint64_t ReadVarintAtBitOffset(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& bitOffset,
+    std::endian endianness
+)
+{
+    // Read 8 varint bytes at once into LE byte order, where BE has byte 0 in the high bits.
+    uint64_t bytes = ReadBitString64(data, bitOffset, 64, endianness);
+    if (endianness == std::endian::big)
+    {
+        bytes = ByteSwap64(bytes);
+    }
+
+    const uint64_t terminatorBits = ~bytes & 0x8080808080808080;
+    if (terminatorBits != 0) [[likely]]
+    {
+        bitOffset += (std::countr_zero(terminatorBits) / CHAR_BIT + 1) * CHAR_BIT;
+        return CompactVarintBytes(bytes & (terminatorBits ^ (terminatorBits - 1)));
+    }
+
+    // Longer than 8 bytes.
+    uint64_t value = CompactVarintBytes(bytes);
+    bitOffset += 8 * CHAR_BIT;
+    for (uint32_t i = 8; i < varintMaxByteCount; ++i)
+    {
+        const uint32_t byte = static_cast<uint32_t>(ReadBitString64(data, bitOffset, CHAR_BIT, endianness)); // Past the end reads 0.
+        bitOffset += CHAR_BIT;
+        value |= uint64_t(byte & 0x7F) << (i * 7);
+        if (!(byte & 0x80))
+        {
+            break;
+        }
+    }
+    return value;
+}
+
+void WriteVarintAtBitOffset(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& bitOffset,
+    std::endian endianness,
+    uint64_t value
+)
+{
+    uint8_t bytes[varintMaxByteCount + 6] = {}; // Padded for 8-byte loads.
+    const uint32_t byteCount = EncodeVarint(value, /*out*/ bytes);
+
+    // Write up to 8 bytes at a time, ordered so that byte 0 comes first in the bitstream.
+    for (uint32_t byteIndex = 0; byteIndex < byteCount; byteIndex += sizeof(uint64_t))
+    {
+        const uint32_t chunkByteCount = std::min(byteCount - byteIndex, uint32_t(sizeof(uint64_t)));
+        const uint32_t chunkBitSize = chunkByteCount * CHAR_BIT;
+        const uint64_t chunk = (endianness == std::endian::big)
+            ? LoadUnalignedBe64(bytes + byteIndex) >> (64 - chunkBitSize)
+            : LoadUnalignedLe64(bytes + byteIndex);
+        WriteBitString64(data, bitOffset, chunkBitSize, endianness, chunk);
+        bitOffset += chunkBitSize;
+    }
+}
+
+size_t ReadVarintArray(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& byteOffset,
+    std::span<uint32_t> values
+)
+{
+    return ReadVarintArrayImpl(data, /*inout*/ byteOffset, values);
+}
+
+size_t ReadVarintArray(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& byteOffset,
+    std::span<uint64_t> values
+)
+{
+    return ReadVarintArrayImpl(data, /*inout*/ byteOffset, values);
+}
+
+void CopyBits(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    size_t destinationBitOffset,
+    std::span<uint8_t const> source, // May overlap destination.
+    size_t sourceBitOffset,
+    size_t bitCount,
+    std::endian endianness
+)
+{
+    // Clamp to the bits within both.
+    const size_t destinationBitSize = destination.size_bytes() * CHAR_BIT;
+    const size_t sourceBitSize = source.size_bytes() * CHAR_BIT;
+    if (destinationBitOffset >= destinationBitSize || sourceBitOffset >= sourceBitSize)
+    {
+        return;
+    }
+    bitCount = std::min({bitCount, destinationBitSize - destinationBitOffset, sourceBitSize - sourceBitOffset});
+
+    // Copy backward (from the end) only when the destination overlaps after the source.
+    const uintptr_t destinationAddress = reinterpret_cast<uintptr_t>(destination.data()) + destinationBitOffset / CHAR_BIT;
+    const uintptr_t sourceAddress = reinterpret_cast<uintptr_t>(source.data()) + sourceBitOffset / CHAR_BIT;
+    if (bitCount == 0 || (destinationAddress == sourceAddress && (destinationBitOffset & 7) == (sourceBitOffset & 7)))
+    {
+        return;
+    }
+    const bool isBackward = destinationAddress > sourceAddress
+        || (destinationAddress == sourceAddress && (destinationBitOffset & 7) > (sourceBitOffset & 7));
+    const bool isBeData = (endianness == std::endian::big);
+
+    // Split into the head bits up to the first destination byte boundary, whole destination bytes,
+    // and tail bits, where only the head and tail merge with the existing destination bits.
+    // The whole bytes read one source byte past their last bit when shifted, which must exist, or
+    // else the last whole byte moves into the tail.
+    const size_t headBitCount = std::min((CHAR_BIT - (destinationBitOffset & 7)) & 7, bitCount);
+    const size_t bodyDestinationByteOffset = (destinationBitOffset + headBitCount) / CHAR_BIT;
+    const size_t bodySourceBitOffset = sourceBitOffset + headBitCount;
+    const uint32_t bodyBitShift = static_cast<uint32_t>(bodySourceBitOffset & 7);
+    size_t bodyByteCount = (bitCount - headBitCount) / CHAR_BIT;
+    if (bodyBitShift > 0 && bodyByteCount > 0 && bodySourceBitOffset / CHAR_BIT + bodyByteCount >= source.size_bytes())
+    {
+        --bodyByteCount;
+    }
+    const size_t tailBitOffset = headBitCount + bodyByteCount * CHAR_BIT;
+    const size_t tailBitCount = bitCount - tailBitOffset; // < 16
+
+    auto copyHead = [&]()
+    {
+        if (headBitCount > 0)
+        {
+            const uint32_t value = ReadBitString(source, sourceBitOffset, headBitCount, endianness);
+            WriteBitString(destination, destinationBitOffset, headBitCount, endianness, value);
+        }
+    };
+    auto copyTail = [&]()
+    {
+        if (tailBitCount > 0)
+        {
+            const uint32_t value = ReadBitString(source, sourceBitOffset + tailBitOffset, tailBitCount, endianness);
+            WriteBitString(destination, destinationBitOffset + tailBitOffset, tailBitCount, endianness, value);
+        }
+    };
+
+    if (!isBackward)
+    {
+        copyHead();
+    }
+    else
+    {
+        copyTail();
+    }
+    CopyShiftedBytes(
+        destination.data() + bodyDestinationByteOffset,
+        source.data() + bodySourceBitOffset / CHAR_BIT,
+        bodyByteCount,
+        bodyBitShift,
+        isBeData,
+        isBackward
+    );
+    if (!isBackward)
+    {
+        copyTail();
+    }
+    else
+    {
+        copyHead();
+    }
+}
+
+void ShiftBits(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    std::span<uint8_t const> source, // May overlap destination.
+    ptrdiff_t bitShift,
+    size_t bitCount, // Destination bits written, clamped to the destination.
+    std::endian endianness
+)
+{
+    bitCount = std::min(bitCount, destination.size_bytes() * CHAR_BIT);
+    const size_t sourceBitSize = source.size_bytes() * CHAR_BIT;
+    const bool reversedBitsInByte = (endianness == std::endian::big);
+
+    // Destination bits [beginBitOffset, beginBitOffset + copyBitCount) come from the source, and the
+    // rest are zero. Clear after copying, since the cleared bits may be source bits when in place.
+    const size_t beginBitOffset = (bitShift < 0) ? std::min(size_t(0) - size_t(bitShift), bitCount) : 0;
+    const size_t sourceBitOffset = (bitShift < 0) ? 0 : size_t(bitShift);
+    const size_t copyBitCount = (sourceBitOffset < sourceBitSize)
+        ? std::min(bitCount - beginBitOffset, sourceBitSize - sourceBitOffset)
+        : 0;
+    CopyBits(destination, beginBitOffset, source, sourceBitOffset, copyBitCount, endianness);
+    ClearBitRange(destination, 0, beginBitOffset, reversedBitsInByte);
+    ClearBitRange(destination, beginBitOffset + copyBitCount, bitCount - beginBitOffset - copyBitCount, reversedBitsInByte);
+}
+
+void ShiftBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    ptrdiff_t bitShift,
+    size_t bitCount, // Bits written, clamped to data.
+    std::endian endianness
+)
+{
+    ShiftBits(data, data, bitShift, bitCount, endianness);
+}
+
+void CombineBits(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    size_t destinationBitOffset,
+    std::span<uint8_t const> sourceA,
+    size_t sourceABitOffset,
+    std::span<uint8_t const> sourceB,
+    size_t sourceBBitOffset,
+    size_t bitCount,
+    BitOperation operation,
+    std::endian endianness
+)
+{
+    // Clamp to the bits within all three.
+    const size_t destinationBitSize = destination.size_bytes() * CHAR_BIT;
+    const size_t sourceABitSize = sourceA.size_bytes() * CHAR_BIT;
+    const size_t sourceBBitSize = sourceB.size_bytes() * CHAR_BIT;
+    if (destinationBitOffset >= destinationBitSize || sourceABitOffset >= sourceABitSize || sourceBBitOffset >= sourceBBitSize)
+    {
+        return;
+    }
+    bitCount = std::min({
+        bitCount,
+        destinationBitSize - destinationBitOffset,
+        sourceABitSize - sourceABitOffset,
+        sourceBBitSize - sourceBBitOffset
+    });
+    const bool isBeData = (endianness == std::endian::big);
+
+    auto combineValues = [operation](uint32_t a, uint32_t b) -> uint32_t
+    {
+        switch (operation)
+        {
+        case BitOperation::And: return CombineValues<BitOperation::And>(a, b);
+        case BitOperation::Or: return CombineValues<BitOperation::Or>(a, b);
+        case BitOperation::Xor: return CombineValues<BitOperation::Xor>(a, b);
+        case BitOperation::AndNot: return CombineValues<BitOperation::AndNot>(a, b);
+        }
+        return a;
+    };
+
+    // Split into the head bits up to the first destination byte boundary, whole destination bytes,
+    // and tail bits (< 8), like CopyBits. Shifted sources read one byte past the last bit of each
+    // whole destination byte, which always exists since that bit is not byte aligned.
+    const size_t headBitCount = std::min((CHAR_BIT - (destinationBitOffset & 7)) & 7, bitCount);
+    const size_t bodyByteCount = (bitCount - headBitCount) / CHAR_BIT;
+    const size_t tailBitOffset = headBitCount + bodyByteCount * CHAR_BIT;
+    const size_t tailBitCount = bitCount - tailBitOffset;
+
+    auto combineBitString = [&](size_t bitOffset, size_t bitSize)
+    {
+        const uint32_t a = ReadBitString(sourceA, sourceABitOffset + bitOffset, bitSize, endianness);
+        const uint32_t b = ReadBitString(sourceB, sourceBBitOffset + bitOffset, bitSize, endianness);
+        WriteBitString(destination, destinationBitOffset + bitOffset, bitSize, endianness, combineValues(a, b));
+    };
+
+    if (headBitCount > 0)
+    {
+        combineBitString(0, headBitCount);
+    }
+    if (bodyByteCount > 0)
+    {
+        uint8_t* bodyDestination = destination.data() + (destinationBitOffset + headBitCount) / CHAR_BIT;
+        const size_t bodySourceABitOffset = sourceABitOffset + headBitCount;
+        const size_t bodySourceBBitOffset = sourceBBitOffset + headBitCount;
+        uint8_t const* bodySourceA = sourceA.data() + bodySourceABitOffset / CHAR_BIT;
+        uint8_t const* bodySourceB = sourceB.data() + bodySourceBBitOffset / CHAR_BIT;
+        const uint32_t bitShiftA = static_cast<uint32_t>(bodySourceABitOffset & 7);
+        const uint32_t bitShiftB = static_cast<uint32_t>(bodySourceBBitOffset & 7);
+
+        using CombineShiftedBytesFunction = void (*)(uint8_t*, uint8_t const*, uint32_t, uint8_t const*, uint32_t, size_t, bool);
+        static constexpr CombineShiftedBytesFunction combineShiftedBytesFunctions[] = {
+            &CombineShiftedBytes<BitOperation::And>,
+            &CombineShiftedBytes<BitOperation::Or>,
+            &CombineShiftedBytes<BitOperation::Xor>,
+            &CombineShiftedBytes<BitOperation::AndNot>,
+        };
+        assert(size_t(operation) < std::size(combineShiftedBytesFunctions));
+        combineShiftedBytesFunctions[size_t(operation)](bodyDestination, bodySourceA, bitShiftA, bodySourceB, bitShiftB, bodyByteCount, isBeData);
+    }
+    if (tailBitCount > 0)
+    {
+        combineBitString(tailBitOffset, tailBitCount);
+    }
+}
+
+template <typename PopulationCountFunction>
+BITSTRING_FORCEINLINE void RankSelectIndex::CountBlocksImpl(size_t beginBlockIndex, size_t endBlockIndex, PopulationCountFunction populationCount)
+{
+    constexpr size_t basicBlockByteSize = basicBlockBitSize / CHAR_BIT;
+    const size_t dataByteSize = data_.size_bytes();
+    for (size_t blockIndex = beginBlockIndex; blockIndex < endBlockIndex; ++blockIndex)
+    {
+        uint64_t blockEntry = 0;
+        uint32_t blockSetBitCount = 0;
+        for (uint32_t basicBlockIndex = 0; basicBlockIndex < basicBlocksPerBlock; ++basicBlockIndex)
+        {
+            const size_t byteOffset = (blockIndex * basicBlocksPerBlock + basicBlockIndex) * basicBlockByteSize;
+            uint32_t basicBlockSetBitCount = 0;
+            if (byteOffset + basicBlockByteSize <= dataByteSize) [[likely]]
+            {
+                // Only 8 words, too few for CountBitsInBytes' dispatch and loop overhead to pay off.
+                // The byte order of each word does not matter for counting.
+                uint8_t const* bytes = data_.data() + byteOffset;
+                for (size_t i = 0; i < basicBlockByteSize; i += sizeof(uint64_t))
+                {
+                    basicBlockSetBitCount += populationCount(LoadUnalignedLe64(bytes + i));
+                }
+            }
+            else if (byteOffset < dataByteSize)
+            {
+                basicBlockSetBitCount = static_cast<uint32_t>(CountBitsInBytes(data_.data() + byteOffset, dataByteSize - byteOffset));
+            }
+            if (basicBlockIndex < basicBlocksPerBlock - 1)
+            {
+                blockEntry |= uint64_t(basicBlockSetBitCount) << (32 + basicBlockIndex * basicBlockCountBitSize);
+            }
+            blockSetBitCount += basicBlockSetBitCount;
+        }
+        blockEntries_[blockIndex] = blockEntry | blockSetBitCount;
+    }
+}
+
+#if BITSTRING_X64
+BITSTRING_TARGET_POPCNT
+void RankSelectIndex::CountBlocksPopcnt(size_t beginBlockIndex, size_t endBlockIndex)
+{
+    CountBlocksImpl(beginBlockIndex, endBlockIndex, PopulationCountPopcnt);
+}
+#endif
+
+void RankSelectIndex::CountBlocks(size_t beginBlockIndex, size_t endBlockIndex)
+{
+    #if BITSTRING_X64
+    if (GetCpuFeatures().hasPopcnt)
+    {
+        CountBlocksPopcnt(beginBlockIndex, endBlockIndex);
+        return;
+    }
+    #endif
+    CountBlocksImpl(beginBlockIndex, endBlockIndex, [](uint64_t word) { return uint32_t(std::popcount(word)); });
+}
+
+void RankSelectIndex::Initialize(
+    std::span<uint8_t const> data, // Bitmap referenced (not copied) by the index.
+    bool reversedBitsInByte,
+    uint32_t threadCount
+)
+{
+    data_ = data;
+    reversedBitsInByte_ = reversedBitsInByte;
+
+    const size_t blockCount = GetBitCount() / blockBitSize + 1; // Including a final partial or empty block.
+    assert(blockCount <= UINT32_MAX);
+    blockEntries_.resize(blockCount);
+
+    // Count the set bits of every basic block, which is nearly all the work, splitting only bitmaps
+    // large enough (1MB per thread) to outweigh starting the threads.
+    constexpr size_t minimumBlocksPerThread = 4096;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    threadCount = static_cast<uint32_t>(std::min<size_t>(threadCount, std::max<size_t>(blockCount / minimumBlocksPerThread, 1)));
+    if (threadCount <= 1)
+    {
+        CountBlocks(0, blockCount);
+    }
+    else
+    {
+        const size_t blocksPerThread = (blockCount + threadCount - 1) / threadCount;
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+        for (size_t beginBlockIndex = blocksPerThread; beginBlockIndex < blockCount; beginBlockIndex += blocksPerThread)
+        {
+            threads.emplace_back(&RankSelectIndex::CountBlocks, this, beginBlockIndex, std::min(beginBlockIndex + blocksPerThread, blockCount));
+        }
+        CountBlocks(0, blocksPerThread);
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    // Accumulate the counts, replacing each block's own count with the count before it.
+    upperCounts_.assign((blockCount - 1) / blocksPerUpperBlock + 1, 0);
+    selectSamples_.clear();
+    size_t setBitCount = 0;
+    size_t nextSampledSetBitIndex = 0;
+    for (size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        const size_t upperBlockIndex = blockIndex / blocksPerUpperBlock;
+        if (blockIndex % blocksPerUpperBlock == 0)
+        {
+            upperCounts_[upperBlockIndex] = setBitCount;
+        }
+        const uint64_t blockEntry = blockEntries_[blockIndex];
+        blockEntries_[blockIndex] = (blockEntry & ~uint64_t(UINT32_MAX)) | (setBitCount - upperCounts_[upperBlockIndex]);
+        setBitCount += uint32_t(blockEntry);
+        for (; nextSampledSetBitIndex < setBitCount; nextSampledSetBitIndex += selectSampleInterval)
+        {
+            selectSamples_.push_back(static_cast<uint32_t>(blockIndex));
+        }
+    }
+    setBitCount_ = setBitCount;
+}
+
+BITSTRING_FORCEINLINE uint64_t RankSelectIndex::LoadWord(size_t wordIndex) const
+{
+    return LoadBitOrderWord64(data_, wordIndex, reversedBitsInByte_);
+}
+
+template <typename PopulationCountFunction>
+BITSTRING_FORCEINLINE size_t RankSelectIndex::RankImpl(size_t bitOffset, PopulationCountFunction populationCount) const
+{
+    assert(!blockEntries_.empty());
+    bitOffset = std::min(bitOffset, GetBitCount());
+
+    const size_t blockIndex = bitOffset / blockBitSize;
+    const uint64_t blockEntry = blockEntries_[blockIndex];
+    size_t rank = GetBlockRank(blockIndex);
+    const uint32_t basicBlockIndex = static_cast<uint32_t>(bitOffset / basicBlockBitSize) % basicBlocksPerBlock;
+    for (uint32_t i = 0; i < basicBlockIndex; ++i)
+    {
+        rank += GetBasicBlockCount(blockEntry, i);
+    }
+
+    const size_t endWordIndex = bitOffset / 64;
+    for (size_t wordIndex = bitOffset / basicBlockBitSize * (basicBlockBitSize / 64); wordIndex < endWordIndex; ++wordIndex)
+    {
+        rank += populationCount(LoadWord(wordIndex));
+    }
+
+    // Count the bits before the offset within its word, which are the low bits (LE) or high bits (BE).
+    const uint32_t bitInWord = bitOffset % 64;
+    if (bitInWord > 0)
+    {
+        const uint64_t word = LoadWord(endWordIndex);
+        rank += populationCount(reversedBitsInByte_ ? word >> (64 - bitInWord) : word << (64 - bitInWord));
+    }
+    return rank;
+}
+
+template <typename PopulationCountFunction>
+BITSTRING_FORCEINLINE size_t RankSelectIndex::SelectImpl(size_t setBitIndex, PopulationCountFunction populationCount) const
+{
+    if (setBitIndex >= setBitCount_)
+    {
+        return bitOffsetNotFound;
+    }
+
+    // The samples before and after the set bit bound the blocks that may hold it. Find the last block
+    // with no more set bits before it than setBitIndex, binary searching only sparse stretches, since
+    // scanning a few adjacent entries (8 per cache line) beats a cache miss per search step.
+    constexpr size_t linearSearchBlockCount = 16;
+    const size_t sampleIndex = setBitIndex / selectSampleInterval;
+    size_t blockIndex = selectSamples_[sampleIndex];
+    size_t lastBlockIndex = (sampleIndex + 1 < selectSamples_.size()) ? selectSamples_[sampleIndex + 1] : blockEntries_.size() - 1;
+    while (lastBlockIndex - blockIndex > linearSearchBlockCount)
+    {
+        const size_t middleBlockIndex = blockIndex + (lastBlockIndex - blockIndex + 1) / 2;
+        if (GetBlockRank(middleBlockIndex) <= setBitIndex)
+        {
+            blockIndex = middleBlockIndex;
+        }
+        else
+        {
+            lastBlockIndex = middleBlockIndex - 1;
+        }
+    }
+    while (blockIndex < lastBlockIndex && GetBlockRank(blockIndex + 1) <= setBitIndex)
+    {
+        ++blockIndex;
+    }
+
+    // Narrow to the basic block, then the word.
+    const uint64_t blockEntry = blockEntries_[blockIndex];
+    size_t remainingSetBitCount = setBitIndex - GetBlockRank(blockIndex);
+    size_t wordIndex = blockIndex * (blockBitSize / 64);
+    for (uint32_t basicBlockIndex = 0; basicBlockIndex < basicBlocksPerBlock - 1; ++basicBlockIndex)
+    {
+        const uint32_t basicBlockSetBitCount = GetBasicBlockCount(blockEntry, basicBlockIndex);
+        if (remainingSetBitCount < basicBlockSetBitCount)
+        {
+            break;
+        }
+        remainingSetBitCount -= basicBlockSetBitCount;
+        wordIndex += basicBlockBitSize / 64;
+    }
+
+    for (const size_t endWordIndex = wordIndex + basicBlockBitSize / 64; wordIndex < endWordIndex; ++wordIndex)
+    {
+        const uint64_t word = LoadWord(wordIndex);
+        const uint32_t wordSetBitCount = populationCount(word);
+        if (remainingSetBitCount < wordSetBitCount)
+        {
+            // BE words hold later bits in lower bit indices, so count set bits from the other end.
+            const uint32_t bitInWord = reversedBitsInByte_
+                ? 63 - SelectBitInWord(word, wordSetBitCount - 1 - static_cast<uint32_t>(remainingSetBitCount))
+                : SelectBitInWord(word, static_cast<uint32_t>(remainingSetBitCount));
+            return wordIndex * 64 + bitInWord;
+        }
+        remainingSetBitCount -= wordSetBitCount;
+    }
+    return bitOffsetNotFound; // Only reachable if the index does not match the bitmap.
+}
+
+#if BITSTRING_X64
+BITSTRING_TARGET_POPCNT
+size_t RankSelectIndex::RankPopcnt(size_t bitOffset) const
+{
+    return RankImpl(bitOffset, PopulationCountPopcnt);
+}
+
+BITSTRING_TARGET_POPCNT
+size_t RankSelectIndex::SelectPopcnt(size_t setBitIndex) const
+{
+    return SelectImpl(setBitIndex, PopulationCountPopcnt);
+}
+#endif
+
+size_t RankSelectIndex::Rank(size_t bitOffset) const
+{
+    #if BITSTRING_X64
+    if (GetCpuFeatures().hasPopcnt)
+    {
+        return RankPopcnt(bitOffset);
+    }
+    #endif
+    return RankImpl(bitOffset, [](uint64_t word) { return uint32_t(std::popcount(word)); });
+}
+
+size_t RankSelectIndex::Select(size_t setBitIndex) const
+{
+    #if BITSTRING_X64
+    if (GetCpuFeatures().hasPopcnt)
+    {
+        return SelectPopcnt(setBitIndex);
+    }
+    #endif
+    return SelectImpl(setBitIndex, [](uint64_t word) { return uint32_t(std::popcount(word)); });
+}
+
+// The serialized layout is the bit count, set bit count, and bit order as uint64's, followed by the
+// upper counts, block entries, and select samples, whose sizes all follow from the first two.
+size_t RankSelectIndex::GetSerializedByteSize() const noexcept
+{
+    return (3 + upperCounts_.size() + blockEntries_.size()) * sizeof(uint64_t) + selectSamples_.size() * sizeof(uint32_t);
+}
+
+bool RankSelectIndex::Serialize(std::span<uint8_t> serialized) const
+{
+    if (serialized.size_bytes() < GetSerializedByteSize())
+    {
+        return false;
+    }
+
+    uint8_t* output = serialized.data();
+    auto write64 = [&](uint64_t value)
+    {
+        StoreUnalignedLe64(output, value);
+        output += sizeof(uint64_t);
+    };
+    write64(GetBitCount());
+    write64(setBitCount_);
+    write64(reversedBitsInByte_);
+    for (uint64_t upperCount : upperCounts_)
+    {
+        write64(upperCount);
+    }
+    for (uint64_t blockEntry : blockEntries_)
+    {
+        write64(blockEntry);
+    }
+    for (uint32_t selectSample : selectSamples_)
+    {
+        StoreUnalignedLe32(output, selectSample);
+        output += sizeof(uint32_t);
+    }
+    return true;
+}
+
+bool RankSelectIndex::Deserialize(std::span<uint8_t const> serialized, std::span<uint8_t const> data)
+{
+    constexpr size_t headerByteSize = 3 * sizeof(uint64_t);
+    if (serialized.size_bytes() < headerByteSize)
+    {
+        return false;
+    }
+
+    uint8_t const* input = serialized.data();
+    auto read64 = [&]() -> uint64_t
+    {
+        const uint64_t value = LoadUnalignedLe64(input);
+        input += sizeof(uint64_t);
+        return value;
+    };
+    const uint64_t bitCount = read64();
+    const uint64_t setBitCount = read64();
+    const uint64_t reversedBitsInByte = read64();
+    if (bitCount != uint64_t(data.size_bytes()) * CHAR_BIT || setBitCount > bitCount || reversedBitsInByte > 1)
+    {
+        return false;
+    }
+
+    const size_t blockCount = static_cast<size_t>(bitCount / blockBitSize + 1);
+    const size_t upperBlockCount = (blockCount - 1) / blocksPerUpperBlock + 1;
+    const size_t selectSampleCount = static_cast<size_t>((setBitCount + selectSampleInterval - 1) / selectSampleInterval);
+    if (serialized.size_bytes() != headerByteSize + (upperBlockCount + blockCount) * sizeof(uint64_t) + selectSampleCount * sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    // Load into locals and validate everything Rank and Select rely on before replacing anything, so
+    // a malformed index is rejected rather than indexing out of bounds, and a failed load leaves the
+    // index unchanged.
+    std::vector<uint64_t> upperCounts(upperBlockCount);
+    std::vector<uint64_t> blockEntries(blockCount);
+    std::vector<uint32_t> selectSamples(selectSampleCount);
+    for (uint64_t& upperCount : upperCounts)
+    {
+        upperCount = read64();
+    }
+    for (uint64_t& blockEntry : blockEntries)
+    {
+        blockEntry = read64();
+    }
+    for (uint32_t& selectSample : selectSamples)
+    {
+        selectSample = LoadUnalignedLe32(input);
+        input += sizeof(uint32_t);
+    }
+
+    // Block ranks must continue from one block to the next (with each upper block's first entry 0),
+    // and each block's stored basic block counts (all but the last) must fit before the next rank.
+    auto getBlockRank = [&](size_t blockIndex) -> uint64_t
+    {
+        return upperCounts[blockIndex / blocksPerUpperBlock] + uint32_t(blockEntries[blockIndex]);
+    };
+    for (size_t upperBlockIndex = 0; upperBlockIndex < upperBlockCount; ++upperBlockIndex)
+    {
+        if (uint32_t(blockEntries[upperBlockIndex * blocksPerUpperBlock]) != 0)
+        {
+            return false;
+        }
+    }
+    uint64_t blockRank = 0;
+    for (size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        if (getBlockRank(blockIndex) != blockRank)
+        {
+            return false;
+        }
+        uint64_t blockSetBitCount = 0;
+        for (uint32_t basicBlockIndex = 0; basicBlockIndex < basicBlocksPerBlock - 1; ++basicBlockIndex)
+        {
+            const uint32_t basicBlockSetBitCount = GetBasicBlockCount(blockEntries[blockIndex], basicBlockIndex);
+            if (basicBlockSetBitCount > basicBlockBitSize)
+            {
+                return false;
+            }
+            blockSetBitCount += basicBlockSetBitCount;
+        }
+        const uint64_t nextBlockRank = (blockIndex + 1 < blockCount) ? getBlockRank(blockIndex + 1) : setBitCount;
+        if (nextBlockRank < blockRank + blockSetBitCount || nextBlockRank - blockRank > blockBitSize)
+        {
+            return false;
+        }
+        blockRank = nextBlockRank;
+    }
+
+    // Each sample must be the block holding its set bit, which also keeps the samples increasing.
+    for (size_t sampleIndex = 0; sampleIndex < selectSampleCount; ++sampleIndex)
+    {
+        const uint64_t sampledSetBitIndex = uint64_t(sampleIndex) * selectSampleInterval;
+        const size_t sampledBlockIndex = selectSamples[sampleIndex];
+        if (sampledBlockIndex >= blockCount || getBlockRank(sampledBlockIndex) > sampledSetBitIndex)
+        {
+            return false;
+        }
+        if (sampledBlockIndex + 1 < blockCount && getBlockRank(sampledBlockIndex + 1) <= sampledSetBitIndex)
+        {
+            return false;
+        }
+    }
+
+    upperCounts_ = std::move(upperCounts);
+    blockEntries_ = std::move(blockEntries);
+    selectSamples_ = std::move(selectSamples);
+    data_ = data;
+    reversedBitsInByte_ = (reversedBitsInByte != 0);
+    setBitCount_ = static_cast<size_t>(setBitCount);
+    return true;
+}
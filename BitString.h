@@ -1,7 +1,27 @@
 ﻿// Needs C++20.
+#pragma once
+
 #include <stdint.h> // uint32_t
+#include <stddef.h> // ptrdiff_t
+#include <climits>  // CHAR_BIT
+#include <cstring>  // memcpy
 #include <bit>      // std::endian
 #include <span>     // std::span
+#include <iterator> // std::random_access_iterator_tag
+#include <algorithm>
+#include <type_traits>
+#include <utility>  // std::exchange
+#include <vector>
+#include <assert.h>
+#if defined(_MSC_VER)
+#include <stdlib.h> // _byteswap_uint64, _byteswap_ulong
+#endif
+
+#if defined(_MSC_VER)
+#define BITSTRING_FORCEINLINE __forceinline
+#else
+#define BITSTRING_FORCEINLINE inline __attribute__((always_inline))
+#endif
 
 // Reads a contiguous series of bits from the given bit offset, returning as a uint.
 // The caller can then bitcast the result to a more specific type, like float16.
@@ -75,6 +95,103 @@ void WriteBitString(
     uint32_t newValue
 );
 
+// 64-bit versions of ReadBitString/WriteBitString, supporting any bit size 1-64 at any bit offset
+// in a single pass, such as 48-bit MAC addresses or doubles at misaligned offsets.
+// Invalid bitOffset's outside data are discarded (bits past the end of data read as 0).
+// Bit sizes larger than 64 are clamped.
+//
+// Example:
+//      double d = std::bit_cast<double>(ReadBitString64(data, 5, 64, std::endian::little));
+//
+uint64_t ReadBitString64(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitSize, // Must be <= 64
+    std::endian endianness
+);
+
+void WriteBitString64(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitSize, // Must be <= 64
+    std::endian endianness,
+    uint64_t newValue
+);
+
+// Reads values.size() consecutive elements of bitSize bits each, starting at the given bit offset.
+// Equivalent to calling ReadBitString for each element at bitOffset + i * bitSize, but much faster
+// for large arrays since the bounds math and byte reversal are hoisted out of the per-element loop.
+// Elements partially or fully outside data read the same as ReadBitString would (discarded bits are 0).
+//
+// Example:
+//      uint32_t values[100];
+//      ReadBitStringArray(data, 0, 13, std::endian::big, values);
+//      // values now holds 100 13-bit elements.
+//
+void ReadBitStringArray(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset, // Bit offset of the first element.
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    std::span<uint32_t> values // Receives values.size() elements.
+);
+
+// Writes values.size() consecutive elements of bitSize bits each, starting at the given bit offset.
+// Equivalent to calling WriteBitString for each element at bitOffset + i * bitSize, but much faster
+// for large arrays since values are accumulated in a register and emitted as whole words, with only
+// the first and last partial bytes merged with the existing data.
+// Values are masked to bitSize. Elements outside data are discarded.
+void WriteBitStringArray(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset, // Bit offset of the first element.
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    std::span<uint32_t const> values
+);
+
+// Converts an array of elementCount bitSize-bit elements (starting at bit 0) from one endianness
+// layout to the other, preserving each element's value, equivalent to reading each element with
+// ReadBitString and writing it back with the other endianness. Conceptually that reverses the bits
+// within each byte and then within each element (see the README), but it is done in bulk by:
+//
+//  - bitSize 1, 2, 4: permuting the bit groups within each byte via a pshufb nibble table (AVX2).
+//  - bitSize 8, 16, 24, 32: reversing the bytes of each element (pshufb for 16 and 32 with AVX2).
+//  - others: unpacking and repacking chunks with the width-specialized array kernels.
+//
+// The destination may be the source itself (converting in place), but must not otherwise overlap.
+// Elements past the end of either are not converted.
+//
+// Example:
+//      ConvertBitStringEndianness(leSamples, beCapture, 13, sampleCount, std::endian::big, std::endian::little);
+//
+void ConvertBitStringEndianness(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    std::span<uint8_t const> source,
+    size_t bitSize, // Must be <= 32
+    size_t elementCount,
+    std::endian sourceEndianness,
+    std::endian destinationEndianness
+);
+
+// Reverses the bits within each byte, converting a bitmap between the normal (LSB-first) bit order
+// and reversedBitsInByte (MSB-first) order, e.g. before handing it to a kernel supporting only one.
+// Equivalent to ConvertBitStringEndianness with bitSize 1, using a pshufb nibble table with AVX2
+// (else the same table per byte). The destination may be the source itself, but must not otherwise
+// overlap. Bytes past the end of either are not reversed.
+//
+// Example:
+//      ReverseBitsInBytes(msbFirstBitmap, lsbFirstBitmap);
+//
+void ReverseBitsInBytes(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    std::span<uint8_t const> source
+);
+
+// In place version.
+void ReverseBitsInBytes(
+    std::span<uint8_t> data // Size limited to 500GB's on 32-bit systems.
+);
+
 // Basically like the x86 bts instruction, except it can invert indices in bytes for BE.
 // Invalid bitOffset's outside data are discarded.
 void SetSingleBit(
@@ -82,3 +199,1925 @@ void SetSingleBit(
     size_t bitOffset,
     bool reversedBitsInByte
 );
+
+// Companions of SetSingleBit with the same bit order semantics, like the x86 bt/btr/btc/bts
+// instructions. Invalid bitOffset's outside data are discarded (testing as false).
+bool TestSingleBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+);
+
+void ClearSingleBit(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+);
+
+void ToggleSingleBit(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+);
+
+// Sets the bit, returning whether it was already set, such as for marking visited nodes.
+bool TestAndSetSingleBit(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+);
+
+// Batched versions of the single bit functions, applying each bit offset in order (so repeated
+// offsets behave the same as separate calls). For random offsets into large bitmaps, the bytes of
+// upcoming offsets are prefetched to overlap the cache misses. Offsets sorted in increasing order
+// take a faster path that merges all offsets within the same 64-bit word into one update.
+void SetSingleBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte
+);
+
+void ClearSingleBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte
+);
+
+void ToggleSingleBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte
+);
+
+void TestSingleBits(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte,
+    std::span<bool> results // Must be the same size as bitOffsets.
+);
+
+// Returns the number of bits newly set (those not already set, nor set earlier in the same batch).
+// The optional wasSet receives whether each bit was already set.
+size_t TestAndSetSingleBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    std::span<size_t const> bitOffsets,
+    bool reversedBitsInByte,
+    std::span<bool> wasSet = {} // Empty, or the same size as bitOffsets.
+);
+
+// Sets, clears, or flips bitCount bits starting at bitOffset, generalizing SetSingleBit to ranges.
+// Only the first and last partial bytes are masked, with the whole bytes between set by memset
+// (or flipped 8 bytes at a time). Bits outside data are discarded.
+//
+// Example:
+//      SetBitRange(bitmap, 1'000'003, 4'800'015, false); // Sets bits 1,000,003 to 5,800,017.
+//
+void SetBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+);
+
+void ClearBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+);
+
+void FlipBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+);
+
+// Fills the bit range with a repeating byte pattern, aligned to the bytes of data, so every byte
+// within the range becomes pattern, and partial bytes take just the pattern bits within the range.
+// e.g. 0x55 sets every even bit and clears every odd bit (in the normal bit order).
+void FillBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte,
+    uint8_t pattern
+);
+
+// Reverses the order of the bitCount bits starting at bitOffset, so the first bit of the range swaps
+// with the last, with the same bit order semantics as SetBitRange. The bytes spanning the range are
+// reversed (both the byte order and the bits within them) from both ends 32 bytes at a time with
+// AVX2, then shifted back into place when the range is not symmetric within them. Bits outside
+// data are discarded.
+//
+// Example:
+//      ReverseBitRange(bitmap, 3, 100, false); // Bit 3 swaps with bit 102, 4 with 101, ...
+//
+void ReverseBitRange(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+);
+
+// Counts the set bits within the range (population count), with the same bit order semantics as
+// SetBitRange. Only the first and last partial bytes are masked, with the whole bytes between counted
+// by the popcnt instruction, or a Harley-Seal AVX2 count for large ranges. Bits outside data are
+// not counted. The rank of a bit (the set bits before it) is CountBits(data, 0, bitOffset, ...).
+//
+// Example:
+//      double density = double(CountBits(bitmap, 1'000'003, 4'800'015, false)) / 4'800'015;
+//
+size_t CountBits(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitCount,
+    bool reversedBitsInByte
+);
+
+constexpr size_t bitOffsetNotFound = ~size_t(0); // Returned by bit searches finding no match.
+
+// Returns the offset of the first set (or clear) bit at or after bitOffset, or bitOffsetNotFound,
+// with the same bit order semantics as SetSingleBit. Searches 64-bit words with tzcnt (or lzcnt for
+// reversed bits), skipping runs of words without a match 64 bytes at a time with AVX2, so sparse
+// regions cost far less than testing each bit. Bits past the end of data are never found.
+//
+// Example:
+//      for (size_t i = FindNextSetBit(bitmap, 0, false); i != bitOffsetNotFound; i = FindNextSetBit(bitmap, i + 1, false))
+//
+size_t FindNextSetBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+);
+
+size_t FindNextClearBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+);
+
+// Returns the offset of the last set (or clear) bit at or before bitOffset, or bitOffsetNotFound.
+// Offsets past the end search from the last bit, so bitOffsetNotFound finds the last of all.
+size_t FindPrevSetBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+);
+
+size_t FindPrevClearBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    bool reversedBitsInByte
+);
+
+// Gathers the bits of value selected by fieldMask into the contiguous low bits of the result, like
+// the BMI2 pext instruction. Useful for pulling several non-contiguous fields out of a word at once.
+// Uses pext when the CPU has a fast implementation (not the microcoded one on AMD before Zen 3),
+// else a portable fallback that costs one iteration per contiguous field in the mask.
+//
+// Example:
+//      GatherBits(0xABCD, 0xF0F0) == 0xAC
+//
+uint64_t GatherBits(uint64_t value, uint64_t fieldMask);
+
+// Scatters the contiguous low bits of value into the bit positions selected by fieldMask, like the
+// BMI2 pdep instruction. The inverse of GatherBits.
+//
+// Example:
+//      ScatterBits(0xAC, 0xF0F0) == 0xA0C0
+//
+uint64_t ScatterBits(uint64_t value, uint64_t fieldMask);
+
+// Bulk versions of GatherBits/ScatterBits, applying the same fieldMask to every value.
+void GatherBitsArray(
+    std::span<uint64_t const> values,
+    uint64_t fieldMask,
+    std::span<uint64_t> results // Must be the same size as values.
+);
+
+void ScatterBitsArray(
+    std::span<uint64_t const> values,
+    uint64_t fieldMask,
+    std::span<uint64_t> results // Must be the same size as values.
+);
+
+// Reads bitSize bits like ReadBitString, then gathers the bits selected by fieldMask into the low
+// bits of the result, like GatherBits.
+uint32_t ReadBitFields(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    uint32_t fieldMask
+);
+
+// Scatters the low bits of newFieldValues into the bits selected by fieldMask, like ScatterBits,
+// then writes them into the bitSize bits at bitOffset, leaving bits outside fieldMask unchanged.
+// Mask bits at or beyond bitSize are ignored, so nothing outside the window is written.
+void WriteBitFields(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    uint32_t fieldMask,
+    uint32_t newFieldValues
+);
+
+// Maximum bytes of a LEB128 varint holding a 64-bit value (7 bits per byte).
+constexpr size_t varintMaxByteCount = 10;
+
+// Reads an unsigned LEB128 (protobuf-style) varint at the given byte offset, advancing the offset
+// past it. Each byte holds 7 value bits, least significant group first, with the high bit set on
+// every byte but the last. A varint truncated by the end of data stops there, and at most
+// varintMaxByteCount bytes are read (bits beyond 64 are discarded).
+//
+// Example:
+//      size_t byteOffset = 0;
+//      uint64_t fieldNumberAndType = ReadVarint(record, /*inout*/ byteOffset);
+//      uint64_t length = ReadVarint(record, /*inout*/ byteOffset);
+//
+uint64_t ReadVarint(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& byteOffset
+);
+
+// Writes an unsigned LEB128 varint (1-10 bytes) at the given byte offset, advancing the offset past
+// it. Bytes outside data are discarded.
+void WriteVarint(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& byteOffset,
+    uint64_t value
+);
+
+// Varints at any bit offset, such as between bit-packed fields, where each varint byte k is the
+// 8 bits read like ReadBitString(data, bitOffset + k * 8, 8, endianness). Bits past the end of
+// data read as 0, so a truncated varint ends at the first byte past the end.
+uint64_t ReadVarintAtBitOffset(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& bitOffset,
+    std::endian endianness
+);
+
+void WriteVarintAtBitOffset(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& bitOffset,
+    std::endian endianness,
+    uint64_t value
+);
+
+// Reads up to values.size() consecutive byte-aligned varints, advancing the offset, and returns the
+// number read (fewer only if the data ends first). Equivalent to calling ReadVarint repeatedly, but
+// finds the varint boundaries of 16 bytes at once from their high bits, decoding runs of 1-byte
+// varints 16 at a time and other varints without per-byte branches. The uint32_t form truncates
+// values to 32 bits.
+size_t ReadVarintArray(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& byteOffset,
+    std::span<uint32_t> values
+);
+
+size_t ReadVarintArray(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    /*inout*/ size_t& byteOffset,
+    std::span<uint64_t> values
+);
+
+// Copies bitCount bits from the source bit offset to the destination bit offset, like a bit-level
+// memmove, so the ranges may overlap within the same buffer. Only the destination's first and
+// last partial bytes are merged with their existing bits. The whole bytes between are computed
+// by funnel shifting 8 bytes at a time (or 32 with AVX2), or with memmove if the offsets are
+// equally aligned. Bits outside either span are discarded.
+//
+// Example:
+//      // Append a 1000-bit payload to a stream currently 13 bits long.
+//      CopyBits(stream, 13, payload, 0, 1000, std::endian::little);
+//
+void CopyBits(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    size_t destinationBitOffset,
+    std::span<uint8_t const> source, // May overlap destination.
+    size_t sourceBitOffset,
+    size_t bitCount,
+    std::endian endianness
+);
+
+// Shifts a whole bit string by bitShift bits into the destination, where destination bit i becomes
+// source bit i + bitShift, or 0 outside the source. So a positive shift moves bits toward the start
+// (dropping the first bitShift source bits, e.g. realigning a payload after a 5-bit header), and a
+// negative shift moves them toward the end (inserting zero bits before them). The bit order follows
+// endianness as in CopyBits, so a BE shift toward the start is a left shift of the whole big-endian
+// number. Runs at near memmove speed via CopyBits' funnel shifts.
+//
+// Example:
+//      ShiftBits(payload, packet, 5, payloadBitCount, std::endian::big); // Drop a 5-bit header.
+//
+void ShiftBits(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    std::span<uint8_t const> source, // May overlap destination.
+    ptrdiff_t bitShift,
+    size_t bitCount, // Destination bits written, clamped to the destination.
+    std::endian endianness
+);
+
+// In place version.
+void ShiftBits(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    ptrdiff_t bitShift,
+    size_t bitCount, // Bits written, clamped to data.
+    std::endian endianness
+);
+
+enum class BitOperation
+{
+    And,
+    Or,
+    Xor,
+    AndNot, // a & ~b
+};
+
+// Combines two bit ranges bitwise into a third, each at any bit offset, such as for intersecting
+// bitmap indexes. Both sources are realigned on the fly with funnel shifts (32 bytes at a time with
+// AVX2), without copying them to aligned temporaries, and combined into whole destination bytes,
+// merging only the partial first and last bytes. A source may be the destination itself at the
+// same bit offset (updating it in place), but must not otherwise overlap it. Bits outside any of
+// the three are discarded.
+//
+// Example:
+//      CombineBits(result, 0, result, 0, postings, 13, bitCount, BitOperation::And, std::endian::little);
+//
+void CombineBits(
+    std::span<uint8_t> destination, // Size limited to 500GB's on 32-bit systems.
+    size_t destinationBitOffset,
+    std::span<uint8_t const> sourceA,
+    size_t sourceABitOffset,
+    std::span<uint8_t const> sourceB,
+    size_t sourceBBitOffset,
+    size_t bitCount,
+    BitOperation operation,
+    std::endian endianness
+);
+
+// Number of bytes of readable and writable slack that a PaddedSpan guarantees past its logical end.
+constexpr size_t bitStringPaddingByteCount = 8;
+
+// A span of bytes whose memory is known to extend at least bitStringPaddingByteCount bytes past
+// the logical end (size()). The Read/Write overloads taking it use unconditional unaligned 64-bit
+// loads and stores, with no bounds clamping or variable-length memcpy. The padding bytes may be
+// read, and rewritten with their existing values, but are otherwise left unchanged.
+// Unlike the std::span overloads, bit offsets outside the logical size are invalid (not discarded).
+//
+// Example:
+//      std::vector<uint8_t> buffer(byteSize + bitStringPaddingByteCount);
+//      PaddedSpan<uint8_t const> data(buffer, byteSize);
+//      uint32_t v = ReadBitString(data, 42, 13, std::endian::big);
+//
+template <typename ByteType>
+class PaddedSpan
+{
+public:
+    // The paddedData includes the padding, whereas logicalByteSize excludes it.
+    PaddedSpan(std::span<ByteType> paddedData, size_t logicalByteSize)
+    :   data_(paddedData.data()),
+        size_(logicalByteSize)
+    {
+        assert(paddedData.size_bytes() >= logicalByteSize + bitStringPaddingByteCount);
+    }
+
+    // Allow implicit conversion from mutable to const bytes, like std::span.
+    template <typename OtherByteType>
+        requires std::is_convertible_v<OtherByteType(*)[], ByteType(*)[]>
+    PaddedSpan(PaddedSpan<OtherByteType> const& other)
+    :   data_(other.data()),
+        size_(other.size())
+    {
+    }
+
+    ByteType* data() const noexcept { return data_; }
+    size_t size() const noexcept { return size_; }
+    size_t size_bytes() const noexcept { return size_; }
+    std::span<ByteType> logical_span() const noexcept { return {data_, size_}; }
+
+private:
+    ByteType* data_;
+    size_t size_;
+};
+
+uint32_t ReadBitString(
+    PaddedSpan<uint8_t const> data,
+    size_t bitOffset, // Must be within data.
+    size_t bitSize, // Must be <= 32
+    std::endian endianness
+);
+
+void WriteBitString(
+    PaddedSpan<uint8_t> data,
+    size_t bitOffset, // Must be within data.
+    size_t bitSize, // Must be <= 32
+    std::endian endianness,
+    uint32_t newValue
+);
+
+uint64_t ReadBitString64(
+    PaddedSpan<uint8_t const> data,
+    size_t bitOffset, // Must be within data.
+    size_t bitSize, // Must be <= 64
+    std::endian endianness
+);
+
+void WriteBitString64(
+    PaddedSpan<uint8_t> data,
+    size_t bitOffset, // Must be within data.
+    size_t bitSize, // Must be <= 64
+    std::endian endianness,
+    uint64_t newValue
+);
+
+// Internal helpers shared by the inline templates below and BitString.cpp.
+namespace BitStringDetail
+{
+    inline uint32_t ByteSwap32(uint32_t value)
+    {
+        #if defined(_MSC_VER)
+        return _byteswap_ulong(value);
+        #else
+        return __builtin_bswap32(value);
+        #endif
+    }
+
+    inline uint64_t ByteSwap64(uint64_t value)
+    {
+        #if defined(_MSC_VER)
+        return _byteswap_uint64(value);
+        #else
+        return __builtin_bswap64(value);
+        #endif
+    }
+
+    // Loads 4 bytes from unaligned memory, interpreting them as an LE or BE uint32.
+    inline uint32_t LoadUnalignedLe32(uint8_t const* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return (std::endian::native == std::endian::big) ? ByteSwap32(value) : value;
+    }
+
+    inline uint32_t LoadUnalignedBe32(uint8_t const* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return (std::endian::native == std::endian::big) ? value : ByteSwap32(value);
+    }
+
+    // Loads 8 bytes from unaligned memory, interpreting them as an LE or BE uint64.
+    inline uint64_t LoadUnalignedLe64(uint8_t const* data)
+    {
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        return (std::endian::native == std::endian::big) ? ByteSwap64(value) : value;
+    }
+
+    inline uint64_t LoadUnalignedBe64(uint8_t const* data)
+    {
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        return (std::endian::native == std::endian::big) ? value : ByteSwap64(value);
+    }
+
+    // Stores 4 bytes to unaligned memory in LE or BE byte order.
+    inline void StoreUnalignedLe32(uint8_t* data, uint32_t value)
+    {
+        value = (std::endian::native == std::endian::big) ? ByteSwap32(value) : value;
+        memcpy(data, &value, sizeof(value));
+    }
+
+    inline void StoreUnalignedBe32(uint8_t* data, uint32_t value)
+    {
+        value = (std::endian::native == std::endian::big) ? value : ByteSwap32(value);
+        memcpy(data, &value, sizeof(value));
+    }
+
+    // Stores 8 bytes to unaligned memory in LE or BE byte order.
+    inline void StoreUnalignedLe64(uint8_t* data, uint64_t value)
+    {
+        value = (std::endian::native == std::endian::big) ? ByteSwap64(value) : value;
+        memcpy(data, &value, sizeof(value));
+    }
+
+    inline void StoreUnalignedBe64(uint8_t* data, uint64_t value)
+    {
+        value = (std::endian::native == std::endian::big) ? value : ByteSwap64(value);
+        memcpy(data, &value, sizeof(value));
+    }
+
+    // Loads the 64-bit word holding bits [wordIndex * 64, wordIndex * 64 + 64) in bit order, as LE so
+    // that bit offsets increase upward from bit 0, or BE (for reversed bits) so they increase downward
+    // from bit 63. Bytes past the end of data read as zero.
+    inline uint64_t LoadBitOrderWord64(std::span<uint8_t const> data, size_t wordIndex, bool reversedBitsInByte)
+    {
+        const size_t byteOffset = wordIndex * sizeof(uint64_t);
+        const size_t dataByteSize = data.size_bytes();
+        uint8_t const* wordData = data.data() + byteOffset;
+        uint8_t paddedWordData[sizeof(uint64_t)] = {};
+        if (byteOffset + sizeof(uint64_t) > dataByteSize) [[unlikely]]
+        {
+            if (byteOffset < dataByteSize)
+            {
+                memcpy(paddedWordData, data.data() + byteOffset, dataByteSize - byteOffset);
+            }
+            wordData = paddedWordData;
+        }
+        return reversedBitsInByte ? LoadUnalignedBe64(wordData) : LoadUnalignedLe64(wordData);
+    }
+}
+
+// Calls callback(bitOffset) for every set bit in increasing order, with the same bit order semantics
+// as SetSingleBit, costing O(set bits) plus the word scans of FindNextSetBit over empty regions.
+//
+// Example:
+//      ForEachSetBit(bitmap, false, [&](size_t bitOffset) { nodes[bitOffset].Visit(); });
+//
+template <typename Callback>
+void ForEachSetBit(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    bool reversedBitsInByte,
+    Callback&& callback
+)
+{
+    const size_t wordCount = (data.size_bytes() + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    for (size_t bitOffset = FindNextSetBit(data, 0, reversedBitsInByte); bitOffset != bitOffsetNotFound; )
+    {
+        // Consume the word holding the next set bit (whose earlier bits are all clear), and any
+        // following nonzero words, before searching again.
+        size_t wordIndex = bitOffset / 64;
+        uint64_t word = BitStringDetail::LoadBitOrderWord64(data, wordIndex, reversedBitsInByte);
+        do
+        {
+            for (; word != 0; )
+            {
+                if (reversedBitsInByte)
+                {
+                    const uint32_t bitInWord = std::countl_zero(word);
+                    word ^= uint64_t(0x8000000000000000) >> bitInWord;
+                    callback(wordIndex * 64 + bitInWord);
+                }
+                else
+                {
+                    const uint32_t bitInWord = std::countr_zero(word);
+                    word &= word - 1;
+                    callback(wordIndex * 64 + bitInWord);
+                }
+            }
+            if (++wordIndex >= wordCount)
+            {
+                return;
+            }
+            word = BitStringDetail::LoadBitOrderWord64(data, wordIndex, reversedBitsInByte);
+        } while (word != 0);
+        bitOffset = FindNextSetBit(data, (wordIndex + 1) * 64, reversedBitsInByte);
+    }
+}
+
+// Compile-time specialized versions of ReadBitString/WriteBitString for call sites that know the
+// bit size and endianness up front. They inline completely, folding away the endianness branches,
+// clamping, and masking, and reading/writing a single unaligned 64-bit word with one bswap (when the
+// data endianness is opposite the hardware) rather than a byte-reversal loop. Bit offsets within 8
+// bytes of the end of data fall back to the general functions.
+//
+// Note the write rewrites all 8 bytes of the word (unchanged bytes written back as they were), so
+// unlike WriteBitString, it must not race with other threads writing the neighboring bytes.
+//
+// Example:
+//      uint32_t v = ReadBitString<13, std::endian::big>(data, 42);
+//      WriteBitString<13, std::endian::big>(data, 42, v + 1);
+//
+template <size_t bitSize, std::endian endianness>
+BITSTRING_FORCEINLINE uint32_t ReadBitString(
+    std::span<uint8_t const> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset
+)
+{
+    static_assert(bitSize >= 1 && bitSize <= 32, "Bit size must be within 1-32.");
+    constexpr uint64_t elementMask = (uint64_t(1) << bitSize) - 1;
+
+    const size_t dataByteOffset = bitOffset / CHAR_BIT;
+    if (data.size_bytes() < sizeof(uint64_t) || dataByteOffset > data.size_bytes() - sizeof(uint64_t)) [[unlikely]]
+    {
+        return ReadBitString(data, bitOffset, bitSize, endianness);
+    }
+
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    if constexpr (endianness == std::endian::big)
+    {
+        const uint64_t word = BitStringDetail::LoadUnalignedBe64(data.data() + dataByteOffset);
+        return static_cast<uint32_t>((word >> (64 - bitSize - bitPhase)) & elementMask);
+    }
+    else
+    {
+        const uint64_t word = BitStringDetail::LoadUnalignedLe64(data.data() + dataByteOffset);
+        return static_cast<uint32_t>((word >> bitPhase) & elementMask);
+    }
+}
+
+template <size_t bitSize, std::endian endianness>
+BITSTRING_FORCEINLINE void WriteBitString(
+    std::span<uint8_t> data, // Size limited to 500GB's on 32-bit systems.
+    size_t bitOffset,
+    uint32_t newValue
+)
+{
+    static_assert(bitSize >= 1 && bitSize <= 32, "Bit size must be within 1-32.");
+    constexpr uint64_t elementMask = (uint64_t(1) << bitSize) - 1;
+
+    const size_t dataByteOffset = bitOffset / CHAR_BIT;
+    if (data.size_bytes() < sizeof(uint64_t) || dataByteOffset > data.size_bytes() - sizeof(uint64_t)) [[unlikely]]
+    {
+        WriteBitString(data, bitOffset, bitSize, endianness, newValue);
+        return;
+    }
+
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    uint8_t* wordData = data.data() + dataByteOffset;
+    if constexpr (endianness == std::endian::big)
+    {
+        const uint32_t shiftAmount = 64 - bitSize - bitPhase;
+        const uint64_t word = BitStringDetail::LoadUnalignedBe64(wordData);
+        const uint64_t newWord = (word & ~(elementMask << shiftAmount)) | ((newValue & elementMask) << shiftAmount);
+        BitStringDetail::StoreUnalignedBe64(wordData, newWord);
+    }
+    else
+    {
+        const uint64_t word = BitStringDetail::LoadUnalignedLe64(wordData);
+        const uint64_t newWord = (word & ~(elementMask << bitPhase)) | ((newValue & elementMask) << bitPhase);
+        BitStringDetail::StoreUnalignedLe64(wordData, newWord);
+    }
+}
+
+// Padded versions of the compile-time specialized templates, which skip the bounds check entirely.
+template <size_t bitSize, std::endian endianness>
+BITSTRING_FORCEINLINE uint32_t ReadBitString(
+    PaddedSpan<uint8_t const> data,
+    size_t bitOffset // Must be within data.
+)
+{
+    static_assert(bitSize >= 1 && bitSize <= 32, "Bit size must be within 1-32.");
+    constexpr uint64_t elementMask = (uint64_t(1) << bitSize) - 1;
+    assert(bitOffset + bitSize <= data.size_bytes() * CHAR_BIT);
+
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    uint8_t const* wordData = data.data() + bitOffset / CHAR_BIT;
+    if constexpr (endianness == std::endian::big)
+    {
+        return static_cast<uint32_t>((BitStringDetail::LoadUnalignedBe64(wordData) >> (64 - bitSize - bitPhase)) & elementMask);
+    }
+    else
+    {
+        return static_cast<uint32_t>((BitStringDetail::LoadUnalignedLe64(wordData) >> bitPhase) & elementMask);
+    }
+}
+
+template <size_t bitSize, std::endian endianness>
+BITSTRING_FORCEINLINE void WriteBitString(
+    PaddedSpan<uint8_t> data,
+    size_t bitOffset, // Must be within data.
+    uint32_t newValue
+)
+{
+    static_assert(bitSize >= 1 && bitSize <= 32, "Bit size must be within 1-32.");
+    constexpr uint64_t elementMask = (uint64_t(1) << bitSize) - 1;
+    assert(bitOffset + bitSize <= data.size_bytes() * CHAR_BIT);
+
+    const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+    uint8_t* wordData = data.data() + bitOffset / CHAR_BIT;
+    if constexpr (endianness == std::endian::big)
+    {
+        const uint32_t shiftAmount = 64 - bitSize - bitPhase;
+        const uint64_t word = BitStringDetail::LoadUnalignedBe64(wordData);
+        BitStringDetail::StoreUnalignedBe64(wordData, (word & ~(elementMask << shiftAmount)) | ((newValue & elementMask) << shiftAmount));
+    }
+    else
+    {
+        const uint64_t word = BitStringDetail::LoadUnalignedLe64(wordData);
+        BitStringDetail::StoreUnalignedLe64(wordData, (word & ~(elementMask << bitPhase)) | ((newValue & elementMask) << bitPhase));
+    }
+}
+
+// Reads consecutive fields sequentially from a bitstream, caching up to 64 bits at a time in a
+// register rather than reloading memory per field like ReadBitString. Each refill tops up the
+// cache with a single unaligned 64-bit load (branch-free, like the bit readers in zstd/brotli),
+// guaranteeing at least 56 bits available afterward, so typical field reads hit the cache.
+// Follows the same LE/BE bit order conventions as ReadBitString, and bits past the end of data
+// read as 0. Near the end of data, refills fall back to byte-wise loads, unless constructed with
+// a PaddedSpan, in which case refills are always single loads (and reads past the logical end
+// are invalid).
+//
+// Example:
+//      BitReader<std::endian::big> reader(data);
+//      uint32_t version = reader.Read(4);
+//      uint32_t length = reader.Read(13);
+//      reader.AlignToByte();
+//
+template <std::endian endianness>
+class BitReader
+{
+public:
+    explicit BitReader(std::span<uint8_t const> data, size_t bitOffset = 0)
+    :   data_(data.data()),
+        dataByteSize_(data.size_bytes()),
+        loadableByteSize_(data.size_bytes())
+    {
+        Seek(bitOffset);
+    }
+
+    explicit BitReader(PaddedSpan<uint8_t const> data, size_t bitOffset = 0)
+    :   data_(data.data()),
+        dataByteSize_(data.size_bytes()),
+        loadableByteSize_(data.size_bytes() + bitStringPaddingByteCount)
+    {
+        Seek(bitOffset);
+    }
+
+    // Reads the next bitSize bits, advancing the position.
+    BITSTRING_FORCEINLINE uint32_t Read(size_t bitSize) // Must be <= 32
+    {
+        const uint32_t value = Peek(bitSize);
+        Consume(static_cast<uint32_t>(bitSize));
+        return value;
+    }
+
+    // Reads the next bitSize bits without advancing the position.
+    BITSTRING_FORCEINLINE uint32_t Peek(size_t bitSize) // Must be <= 32
+    {
+        assert(bitSize <= 32);
+        if (bitCount_ < bitSize) [[unlikely]]
+        {
+            Refill();
+        }
+        return PeekCachedBits(static_cast<uint32_t>(bitSize));
+    }
+
+    // Advances the position by any number of bits.
+    void Skip(size_t bitCount)
+    {
+        if (bitCount <= bitCount_)
+        {
+            Consume(static_cast<uint32_t>(bitCount));
+        }
+        else
+        {
+            Seek(GetBitOffset() + bitCount);
+        }
+    }
+
+    // Advances to the next byte boundary, if not already on one.
+    void AlignToByte()
+    {
+        // Since the position is byteOffset_ * 8 - bitCount_, the bits until the boundary are the
+        // low bits of bitCount_.
+        Consume(bitCount_ & 7);
+    }
+
+    // Moves to an absolute bit offset within the data.
+    void Seek(size_t bitOffset)
+    {
+        byteOffset_ = bitOffset / CHAR_BIT;
+        bitBuffer_ = 0;
+        bitCount_ = 0;
+        Refill();
+        Consume(static_cast<uint32_t>(bitOffset & 7));
+    }
+
+    size_t GetBitOffset() const noexcept
+    {
+        return byteOffset_ * CHAR_BIT - bitCount_;
+    }
+
+    // Returns the remaining bits until the end of data, or 0 if already past the end.
+    size_t GetRemainingBitCount() const noexcept
+    {
+        const size_t dataBitSize = dataByteSize_ * CHAR_BIT;
+        const size_t bitOffset = GetBitOffset();
+        return (bitOffset < dataBitSize) ? dataBitSize - bitOffset : 0;
+    }
+
+    // Tops up the cache to at least 56 bits.
+    //
+    // LE caches bits from the low end:   bitBuffer_ = [.......unfilled.......|oldest cached bits]
+    // BE caches bits from the high end:  bitBuffer_ = [oldest cached bits|.......unfilled.......]
+    //
+    // Each fast refill loads the 8 bytes at byteOffset_ and ORs them in just past the cached bits,
+    // then advances byteOffset_ by however many whole bytes fit. Any bits of a partially fitting
+    // byte land in the cache too, but are identical to those ORed in by the next refill.
+    BITSTRING_FORCEINLINE void Refill()
+    {
+        if (byteOffset_ + sizeof(uint64_t) <= loadableByteSize_) [[likely]]
+        {
+            if constexpr (endianness == std::endian::big)
+            {
+                bitBuffer_ |= BitStringDetail::LoadUnalignedBe64(data_ + byteOffset_) >> bitCount_;
+            }
+            else
+            {
+                bitBuffer_ |= BitStringDetail::LoadUnalignedLe64(data_ + byteOffset_) << bitCount_;
+            }
+            byteOffset_ += (63 - bitCount_) >> 3;
+            bitCount_ |= 56;
+        }
+        else
+        {
+            RefillSlowly();
+        }
+    }
+
+    // Variable-length codes, decoded by counting the leading zeros of the cached bits rather than
+    // reading a bit at a time. "Leading" means the earliest bits in stream order, so BE counts from
+    // the high end of the cache (countl_zero) and LE from the low end (countr_zero). Suffix bits
+    // follow the same order as Read(). The fast paths decode a whole code from the cache after at
+    // most one refill, falling back to a loop only for zero runs longer than the cache.
+
+    // Reads a run of 0 bits terminated by a 1 bit, returning the number of 0's. If the data ends
+    // before any 1 bit, stops at the end, returning the number of 0's until there.
+    BITSTRING_FORCEINLINE uint32_t ReadUnary()
+    {
+        Refill();
+        const uint32_t zeroCount = CountCachedZeros();
+        if (zeroCount < bitCount_) [[likely]]
+        {
+            Consume(zeroCount + 1);
+            return zeroCount;
+        }
+        return ReadUnarySlowly();
+    }
+
+    // Reads an unsigned Exp-Golomb code, like H.264/HEVC ue(v): n 0's, a 1, then an n-bit suffix,
+    // decoding to (1 << n) - 1 + suffix. Codes with 32 or more leading 0's (beyond the H.264 range)
+    // decode as 0xFFFFFFFF.
+    BITSTRING_FORCEINLINE uint32_t ReadExpGolomb()
+    {
+        Refill();
+        const uint32_t zeroCount = CountCachedZeros();
+        if (zeroCount < 16) [[likely]] // Whole code fits in 31 bits, always cached after a refill (>= 56).
+        {
+            const uint32_t codeBitSize = zeroCount * 2 + 1;
+            uint32_t code;
+            if constexpr (endianness == std::endian::big)
+            {
+                // The code read as a whole is (1 << n) + suffix.
+                code = static_cast<uint32_t>(bitBuffer_ >> (64 - codeBitSize));
+            }
+            else
+            {
+                const uint32_t suffix = static_cast<uint32_t>(bitBuffer_ >> (zeroCount + 1)) & ((1u << zeroCount) - 1);
+                code = (1u << zeroCount) | suffix;
+            }
+            Consume(codeBitSize);
+            return code - 1;
+        }
+        return ReadExpGolombSlowly();
+    }
+
+    // Reads a signed Exp-Golomb code, like H.264/HEVC se(v), mapping ue(v) 0,1,2,3,4... to 0,1,-1,2,-2...
+    BITSTRING_FORCEINLINE int32_t ReadSignedExpGolomb()
+    {
+        const uint32_t value = ReadExpGolomb();
+        return (value & 1) ? static_cast<int32_t>((value >> 1) + 1) : -static_cast<int32_t>(value >> 1);
+    }
+
+    // Reads a Rice code with parameter k: a unary quotient q (as ReadUnary) then a k-bit remainder,
+    // decoding to (q << k) + remainder.
+    BITSTRING_FORCEINLINE uint32_t ReadRice(uint32_t k) // Must be <= 32
+    {
+        assert(k <= 32);
+        Refill();
+        const uint32_t quotient = CountCachedZeros();
+        if (quotient + k < bitCount_) [[likely]]
+        {
+            Consume(quotient + 1);
+            const uint32_t remainder = PeekCachedBits(k);
+            Consume(k);
+            return static_cast<uint32_t>(uint64_t(quotient) << k) | remainder; // 64-bit since k may be 32.
+        }
+        const uint32_t slowQuotient = ReadUnary();
+        return static_cast<uint32_t>((uint64_t(slowQuotient) << k) | Read(k));
+    }
+
+    // Reads a Rice code holding a zigzag-folded signed value, like FLAC residuals, mapping
+    // 0,1,2,3,4... to 0,-1,1,-2,2...
+    BITSTRING_FORCEINLINE int32_t ReadSignedRice(uint32_t k) // Must be <= 32
+    {
+        const uint32_t value = ReadRice(k);
+        return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+    }
+
+    // Bulk forms, decoding values.size() consecutive codes.
+    void ReadExpGolombArray(std::span<uint32_t> values)
+    {
+        for (uint32_t& value : values)
+        {
+            value = ReadExpGolomb();
+        }
+    }
+
+    void ReadSignedExpGolombArray(std::span<int32_t> values)
+    {
+        for (int32_t& value : values)
+        {
+            value = ReadSignedExpGolomb();
+        }
+    }
+
+    void ReadRiceArray(uint32_t k, std::span<uint32_t> values)
+    {
+        for (uint32_t& value : values)
+        {
+            value = ReadRice(k);
+        }
+    }
+
+    void ReadSignedRiceArray(uint32_t k, std::span<int32_t> values)
+    {
+        for (int32_t& value : values)
+        {
+            value = ReadSignedRice(k);
+        }
+    }
+
+protected:
+    // Counts the 0's before the first 1 in stream order, including any stale bits past bitCount_.
+    BITSTRING_FORCEINLINE uint32_t CountCachedZeros() const noexcept
+    {
+        if constexpr (endianness == std::endian::big)
+        {
+            return static_cast<uint32_t>(std::countl_zero(bitBuffer_));
+        }
+        else
+        {
+            return static_cast<uint32_t>(std::countr_zero(bitBuffer_));
+        }
+    }
+
+    // Counts zeros across multiple refills, stopping at the end of the data if no 1 bit is found.
+    uint32_t ReadUnarySlowly()
+    {
+        uint32_t zeroCount = 0;
+        while (true)
+        {
+            const uint32_t runLength = std::min(CountCachedZeros(), bitCount_);
+            if (runLength < bitCount_)
+            {
+                Consume(runLength + 1);
+                return zeroCount + runLength;
+            }
+            const size_t remainingBitCount = GetRemainingBitCount();
+            if (runLength >= remainingBitCount)
+            {
+                Consume(static_cast<uint32_t>(remainingBitCount));
+                return zeroCount + static_cast<uint32_t>(remainingBitCount);
+            }
+            zeroCount += runLength;
+            Consume(runLength);
+            Refill();
+        }
+    }
+
+    uint32_t ReadExpGolombSlowly()
+    {
+        const uint32_t zeroCount = ReadUnary();
+        if (zeroCount >= 32)
+        {
+            Skip(zeroCount);
+            return 0xFFFFFFFF;
+        }
+        return ((1u << zeroCount) - 1) + Read(zeroCount);
+    }
+
+    BITSTRING_FORCEINLINE uint32_t PeekCachedBits(uint32_t bitSize) const noexcept
+    {
+        if constexpr (endianness == std::endian::big)
+        {
+            // Double shift so that bitSize 0 yields 0 rather than an undefined shift by 64.
+            return static_cast<uint32_t>((bitBuffer_ >> 1) >> (63 - bitSize));
+        }
+        else
+        {
+            return static_cast<uint32_t>(bitBuffer_ & ((uint64_t(1) << bitSize) - 1));
+        }
+    }
+
+    BITSTRING_FORCEINLINE void Consume(uint32_t bitCount) noexcept
+    {
+        assert(bitCount <= bitCount_);
+        if constexpr (endianness == std::endian::big)
+        {
+            bitBuffer_ <<= bitCount;
+        }
+        else
+        {
+            bitBuffer_ >>= bitCount;
+        }
+        bitCount_ -= bitCount;
+    }
+
+    // Refills one byte at a time near the end of the data, treating bytes past the end as 0.
+    void RefillSlowly()
+    {
+        while (bitCount_ < 56)
+        {
+            const uint64_t byte = (byteOffset_ < dataByteSize_) ? data_[byteOffset_] : 0;
+            if constexpr (endianness == std::endian::big)
+            {
+                bitBuffer_ |= byte << (56 - bitCount_);
+            }
+            else
+            {
+                bitBuffer_ |= byte << bitCount_;
+            }
+            ++byteOffset_;
+            bitCount_ += CHAR_BIT;
+        }
+    }
+
+    uint8_t const* data_;
+    size_t dataByteSize_;
+    size_t loadableByteSize_; // Includes any padding.
+    size_t byteOffset_ = 0; // Next byte to load into the cache.
+    uint64_t bitBuffer_ = 0;
+    uint32_t bitCount_ = 0; // Number of valid cached bits.
+};
+
+// Appends fields sequentially to a bitstream, the writing counterpart to BitReader. Bits accumulate
+// in a 64-bit register and are stored as whole 64-bit words, without reading back the destination
+// like WriteBitString does, except for merging the first and last partial bytes. Follows the same
+// LE/BE bit order conventions as WriteBitString. Call Flush() after the last write to store any
+// remaining bits (which may be called repeatedly, and writing may continue afterward).
+//
+// Writes either into a fixed caller buffer (bits past the end are discarded), or appended to a
+// growable std::vector sink, which is resized to the exact number of bytes written upon Flush().
+//
+// Example:
+//      std::vector<uint8_t> frame;
+//      BitWriter<std::endian::big> writer(frame);
+//      writer.Write(4, version);
+//      writer.Write(13, length);
+//      writer.Flush();
+//
+template <std::endian endianness>
+class BitWriter
+{
+public:
+    explicit BitWriter(std::span<uint8_t> data, size_t bitOffset = 0)
+    :   data_(data.data()),
+        dataByteSize_(data.size_bytes()),
+        byteOffset_(bitOffset / CHAR_BIT)
+    {
+        // Keep the existing bits in the first byte before the starting bit offset.
+        const uint32_t bitPhase = static_cast<uint32_t>(bitOffset & 7);
+        if (bitPhase > 0 && byteOffset_ < dataByteSize_)
+        {
+            const uint8_t existingByte = data_[byteOffset_];
+            if constexpr (endianness == std::endian::big)
+            {
+                bitBuffer_ = uint64_t(existingByte >> (CHAR_BIT - bitPhase)) << (64 - bitPhase);
+            }
+            else
+            {
+                bitBuffer_ = existingByte & ((1u << bitPhase) - 1);
+            }
+        }
+        bitCount_ = bitPhase;
+    }
+
+    // Appends to the end of the sink's existing bytes.
+    explicit BitWriter(std::vector<uint8_t>& sink)
+    :   data_(sink.data()),
+        dataByteSize_(sink.size()),
+        byteOffset_(sink.size()),
+        sink_(&sink)
+    {
+    }
+
+    // Appends the low bitSize bits of value.
+    BITSTRING_FORCEINLINE void Write(size_t bitSize, uint32_t value) // bitSize must be <= 32
+    {
+        assert(bitSize <= 32);
+        const uint32_t bitSize32Bit = static_cast<uint32_t>(bitSize);
+        const uint64_t maskedValue = value & ((uint64_t(1) << bitSize32Bit) - 1);
+        const uint32_t newBitCount = bitCount_ + bitSize32Bit;
+
+        // Since bitSize <= 32, the accumulator overflows by at most 31 bits, which become the start of
+        // the next word.
+        if constexpr (endianness == std::endian::big)
+        {
+            if (newBitCount < 64) [[likely]]
+            {
+                bitBuffer_ |= (maskedValue << 1) << (63 - newBitCount); // Double shift since 64 is undefined.
+                bitCount_ = newBitCount;
+            }
+            else
+            {
+                const uint32_t overflowBitCount = newBitCount - 64;
+                StoreWord(bitBuffer_ | (maskedValue >> overflowBitCount));
+                bitBuffer_ = (maskedValue << 1) << (63 - overflowBitCount);
+                bitCount_ = overflowBitCount;
+            }
+        }
+        else
+        {
+            bitBuffer_ |= maskedValue << bitCount_;
+            if (newBitCount < 64) [[likely]]
+            {
+                bitCount_ = newBitCount;
+            }
+            else
+            {
+                StoreWord(bitBuffer_);
+                bitBuffer_ = maskedValue >> (64 - bitCount_); // bitCount_ >= 32 here, so the shift is in range.
+                bitCount_ = newBitCount - 64;
+            }
+        }
+    }
+
+    // Stores all remaining accumulated bits, merging the final partial byte with existing data.
+    void Flush()
+    {
+        while (bitCount_ >= CHAR_BIT)
+        {
+            if constexpr (endianness == std::endian::big)
+            {
+                StoreByte(static_cast<uint8_t>(bitBuffer_ >> 56));
+                bitBuffer_ <<= CHAR_BIT;
+            }
+            else
+            {
+                StoreByte(static_cast<uint8_t>(bitBuffer_));
+                bitBuffer_ >>= CHAR_BIT;
+            }
+            ++byteOffset_;
+            bitCount_ -= CHAR_BIT;
+        }
+
+        // Write the partial byte, but keep its bits accumulated in case writing continues.
+        if (bitCount_ > 0)
+        {
+            const uint8_t existingByte = (byteOffset_ < dataByteSize_) ? data_[byteOffset_] : 0;
+            if constexpr (endianness == std::endian::big)
+            {
+                const uint8_t keptBitsMask = static_cast<uint8_t>((1u << (CHAR_BIT - bitCount_)) - 1);
+                StoreByte((existingByte & keptBitsMask) | static_cast<uint8_t>(bitBuffer_ >> 56));
+            }
+            else
+            {
+                const uint8_t keptBitsMask = static_cast<uint8_t>(~((1u << bitCount_) - 1));
+                StoreByte((existingByte & keptBitsMask) | static_cast<uint8_t>(bitBuffer_));
+            }
+        }
+
+        if (sink_ != nullptr)
+        {
+            sink_->resize(byteOffset_ + (bitCount_ > 0));
+            data_ = sink_->data();
+            dataByteSize_ = sink_->size();
+        }
+    }
+
+    size_t GetBitOffset() const noexcept
+    {
+        return byteOffset_ * CHAR_BIT + bitCount_;
+    }
+
+protected:
+    BITSTRING_FORCEINLINE void StoreWord(uint64_t word)
+    {
+        if (byteOffset_ + sizeof(uint64_t) > dataByteSize_) [[unlikely]]
+        {
+            if (!EnsureSinkCapacity(byteOffset_ + sizeof(uint64_t)))
+            {
+                // Store only the bytes that fit into the fixed buffer.
+                uint8_t wordBytes[sizeof(uint64_t)];
+                endianness == std::endian::big ? BitStringDetail::StoreUnalignedBe64(wordBytes, word) : BitStringDetail::StoreUnalignedLe64(wordBytes, word);
+                if (byteOffset_ < dataByteSize_)
+                {
+                    memcpy(data_ + byteOffset_, wordBytes, dataByteSize_ - byteOffset_);
+                }
+                byteOffset_ += sizeof(uint64_t);
+                return;
+            }
+        }
+
+        if constexpr (endianness == std::endian::big)
+        {
+            BitStringDetail::StoreUnalignedBe64(data_ + byteOffset_, word);
+        }
+        else
+        {
+            BitStringDetail::StoreUnalignedLe64(data_ + byteOffset_, word);
+        }
+        byteOffset_ += sizeof(uint64_t);
+    }
+
+    void StoreByte(uint8_t byte)
+    {
+        if (byteOffset_ < dataByteSize_ || EnsureSinkCapacity(byteOffset_ + 1))
+        {
+            data_[byteOffset_] = byte;
+        }
+    }
+
+    // Grows the sink (if any) geometrically to at least the given size, returning false for fixed buffers.
+    bool EnsureSinkCapacity(size_t byteSize)
+    {
+        if (sink_ == nullptr)
+        {
+            return false;
+        }
+        if (byteSize > sink_->size())
+        {
+            sink_->resize(std::max(byteSize, sink_->size() * 2));
+            data_ = sink_->data();
+            dataByteSize_ = sink_->size();
+        }
+        return true;
+    }
+
+    uint8_t* data_;
+    size_t dataByteSize_;
+    size_t byteOffset_; // Next byte to store the accumulator to.
+    std::vector<uint8_t>* sink_ = nullptr;
+    uint64_t bitBuffer_ = 0;
+    uint32_t bitCount_ = 0; // Number of accumulated bits not yet stored.
+};
+
+// Reads fields in reverse order, from the end of a bitstream toward the front, as needed by entropy
+// decoders like tANS/FSE which encode forward and decode backward. Reading bitSize bits at position
+// p returns the same value as ReadBitString(data, p - bitSize, bitSize, endianness), then moves the
+// position to p - bitSize. Bits before the start of data read as 0.
+//
+// A 64-bit window of data is cached in a register, tracked by how many bits at its end have been
+// consumed. Each refill slides the window back by whole bytes with a single unaligned load, after
+// which at least 57 bits are available (until reaching the front of the data).
+//
+//      LE window = bytes [windowByteOffset_, +8):   [.........unread.........|consumed_ bits]
+//      BE window = bytes [windowByteOffset_, +8):   [consumed_ bits|.........unread.........]
+//
+// Example:
+//      BackwardBitReader<std::endian::little> reader(data); // Starts at the end.
+//      uint32_t lastField = reader.Read(13);
+//      uint32_t secondToLastField = reader.Read(13);
+//
+template <std::endian endianness>
+class BackwardBitReader
+{
+public:
+    // The bitOffset is the position just past the last bit to read (the end of the data by default).
+    explicit BackwardBitReader(std::span<uint8_t const> data, size_t bitOffset = ~size_t(0))
+    :   data_(data.data()),
+        dataByteSize_(data.size_bytes())
+    {
+        Seek(std::min(bitOffset, dataByteSize_ * CHAR_BIT));
+    }
+
+    // Reads the bitSize bits preceding the current position, moving the position back.
+    BITSTRING_FORCEINLINE uint32_t Read(size_t bitSize) // Must be <= 32
+    {
+        const uint32_t value = Peek(bitSize);
+        consumedBitCount_ += static_cast<uint32_t>(bitSize);
+        return value;
+    }
+
+    // Reads the bitSize bits preceding the current position without moving it.
+    BITSTRING_FORCEINLINE uint32_t Peek(size_t bitSize) // Must be <= 32
+    {
+        assert(bitSize <= 32);
+        const uint32_t bitSize32Bit = static_cast<uint32_t>(bitSize);
+        if (consumedBitCount_ + bitSize32Bit > 64) [[unlikely]]
+        {
+            Refill();
+        }
+
+        // Past the front of the data (consumed >= 64), any remaining bits are 0.
+        if constexpr (endianness == std::endian::big)
+        {
+            const uint64_t unreadBits = (consumedBitCount_ < 64) ? window_ >> consumedBitCount_ : 0;
+            return static_cast<uint32_t>(unreadBits & ((uint64_t(1) << bitSize32Bit) - 1));
+        }
+        else
+        {
+            const uint64_t unreadBits = (consumedBitCount_ < 64) ? window_ << consumedBitCount_ : 0;
+            return static_cast<uint32_t>((unreadBits >> 1) >> (63 - bitSize32Bit)); // Double shift since 64 is undefined.
+        }
+    }
+
+    // Moves the position back by any number of bits.
+    void Skip(size_t bitCount)
+    {
+        const size_t bitOffset = GetBitOffset();
+        Seek(bitOffset - std::min(bitCount, bitOffset));
+    }
+
+    // Moves to an absolute bit offset (just past the next bit to read).
+    void Seek(size_t bitOffset)
+    {
+        assert(bitOffset <= dataByteSize_ * CHAR_BIT);
+        const size_t endByteOffset = (bitOffset + 7) / CHAR_BIT;
+        windowByteOffset_ = (endByteOffset >= sizeof(uint64_t)) ? endByteOffset - sizeof(uint64_t) : 0;
+        consumedBitCount_ = static_cast<uint32_t>((windowByteOffset_ + sizeof(uint64_t)) * CHAR_BIT - bitOffset);
+        LoadWindow();
+    }
+
+    // Returns the current position, which is also the number of bits remaining to read.
+    size_t GetBitOffset() const noexcept
+    {
+        const size_t windowEndBitOffset = (windowByteOffset_ + sizeof(uint64_t)) * CHAR_BIT;
+        return (consumedBitCount_ < windowEndBitOffset) ? windowEndBitOffset - consumedBitCount_ : 0;
+    }
+
+    // Slides the window back over the consumed whole bytes, as far as the front of the data.
+    BITSTRING_FORCEINLINE void Refill()
+    {
+        const size_t byteStep = std::min(size_t(consumedBitCount_ / CHAR_BIT), windowByteOffset_);
+        windowByteOffset_ -= byteStep;
+        consumedBitCount_ -= static_cast<uint32_t>(byteStep * CHAR_BIT);
+        LoadWindow();
+    }
+
+protected:
+    BITSTRING_FORCEINLINE void LoadWindow()
+    {
+        uint8_t const* windowData = data_ + windowByteOffset_;
+        uint8_t stagingBytes[sizeof(uint64_t)] = {};
+        if (dataByteSize_ < sizeof(uint64_t)) [[unlikely]]
+        {
+            // Only for tiny data, where the window extends past the end (zero padded).
+            if (dataByteSize_ > 0)
+            {
+                memcpy(stagingBytes, data_, dataByteSize_);
+            }
+            windowData = stagingBytes;
+        }
+        if constexpr (endianness == std::endian::big)
+        {
+            window_ = BitStringDetail::LoadUnalignedBe64(windowData);
+        }
+        else
+        {
+            window_ = BitStringDetail::LoadUnalignedLe64(windowData);
+        }
+    }
+
+    uint8_t const* data_;
+    size_t dataByteSize_;
+    size_t windowByteOffset_ = 0;
+    uint64_t window_ = 0;
+    uint32_t consumedBitCount_ = 0; // Bits consumed from the end of the window.
+};
+
+constexpr uint32_t huffmanMaxCodeBitSize = 16; // Enough for Deflate (15) and JPEG (16).
+constexpr uint32_t huffmanInvalidSymbol = 0xFFFFFFFF; // Returned for bit patterns not assigned any code.
+
+// One lookup table entry of a Huffman decoding table, either a symbol or a link to a subtable.
+struct HuffmanTableEntry
+{
+    uint32_t value; // Symbol, or the table index of the subtable if subtableBitSize > 0.
+    uint8_t bitSize; // Whole code bit size for a symbol, or the root bit size for a subtable link.
+    uint8_t subtableBitSize; // Bits indexing the subtable, or 0 for a symbol.
+};
+
+// Builds a two-level lookup table for a canonical Huffman code, where the root table is indexed by
+// the next rootBitSize bits of the stream, and codes longer than that link to subtables indexed by
+// their remaining bits. Codes are assigned canonically (as in Deflate and JPEG): in order of
+// increasing bit size, then in the order symbols are listed.
+//
+// Since a code's first bit is always its first bit in the stream, a BE (MSB-first) reader peeks the
+// code bits in order, whereas an LE (LSB-first) reader like Deflate's peeks them reversed, so
+// reversedCodes = true indexes the tables by bit-reversed codes for LE.
+//
+// Returns false if the code is over-subscribed or a bit size is out of range. Incomplete codes are
+// allowed (like JPEG's reserved all-ones code), with unused entries decoding to huffmanInvalidSymbol.
+// The rootBitSize is reduced to the longest code bit size if smaller.
+bool BuildHuffmanTable(
+    std::span<uint16_t const> codeCounts, // Number of codes of each bit size, [0] = 1 bit ... [15] = 16 bits (like JPEG's BITS list).
+    std::span<uint16_t const> symbols, // Symbols in canonical code order (like JPEG's HUFFVAL list).
+    bool reversedCodes,
+    /*inout*/ uint32_t& rootBitSize, // Must be 1 to 16.
+    /*out*/ std::vector<HuffmanTableEntry>& table
+);
+
+// Builds the table from the code bit size of every symbol, 0 meaning the symbol is unused (as Deflate
+// transmits its codes).
+bool BuildHuffmanTable(
+    std::span<uint8_t const> codeBitSizes, // Indexed by symbol, each <= huffmanMaxCodeBitSize.
+    bool reversedCodes,
+    /*inout*/ uint32_t& rootBitSize, // Must be 1 to 16.
+    /*out*/ std::vector<HuffmanTableEntry>& table
+);
+
+// Decodes canonical Huffman codes from a BitReader of the same bit order, such as LE for Deflate
+// or BE for JPEG. Each symbol costs one peek of rootBitSize bits and one table lookup, plus a second
+// lookup only for codes longer than the root table.
+//
+// Example:
+//      HuffmanDecoder<std::endian::little> literalDecoder;
+//      if (!literalDecoder.Initialize(literalCodeBitSizes)) return false;
+//      BitReader<std::endian::little> reader(data);
+//      uint32_t symbol = literalDecoder.DecodeSymbol(reader);
+//
+template <std::endian endianness>
+class HuffmanDecoder
+{
+public:
+    // Initializes from the code bit size of every symbol (like Deflate).
+    bool Initialize(std::span<uint8_t const> codeBitSizes, uint32_t rootBitSize = 9)
+    {
+        rootBitSize_ = rootBitSize;
+        return BuildHuffmanTable(codeBitSizes, endianness == std::endian::little, /*inout*/ rootBitSize_, /*out*/ table_);
+    }
+
+    // Initializes from the count of codes per bit size and the symbols in code order (like JPEG).
+    bool Initialize(std::span<uint16_t const> codeCounts, std::span<uint16_t const> symbols, uint32_t rootBitSize = 9)
+    {
+        rootBitSize_ = rootBitSize;
+        return BuildHuffmanTable(codeCounts, symbols, endianness == std::endian::little, /*inout*/ rootBitSize_, /*out*/ table_);
+    }
+
+    // Decodes the next symbol, or returns huffmanInvalidSymbol without advancing if the next bits
+    // match no code.
+    BITSTRING_FORCEINLINE uint32_t DecodeSymbol(BitReader<endianness>& reader) const
+    {
+        assert(!table_.empty());
+        HuffmanTableEntry entry = table_[reader.Peek(rootBitSize_)];
+        if (entry.subtableBitSize > 0) [[unlikely]]
+        {
+            // The subtable index is the code bits following the root bits.
+            const uint32_t codeBits = reader.Peek(rootBitSize_ + entry.subtableBitSize);
+            const uint32_t subtableIndex = (endianness == std::endian::big)
+                ? codeBits & ((1u << entry.subtableBitSize) - 1)
+                : codeBits >> rootBitSize_;
+            entry = table_[entry.value + subtableIndex];
+        }
+        reader.Skip(entry.bitSize);
+        return entry.value;
+    }
+
+    // Decodes up to symbols.size() symbols, returning how many were decoded before any invalid code.
+    size_t DecodeSymbols(BitReader<endianness>& reader, std::span<uint32_t> symbols) const
+    {
+        for (size_t i = 0, symbolCount = symbols.size(); i < symbolCount; ++i)
+        {
+            const uint32_t symbol = DecodeSymbol(reader);
+            if (symbol == huffmanInvalidSymbol) [[unlikely]]
+            {
+                return i;
+            }
+            symbols[i] = symbol;
+        }
+        return symbols.size();
+    }
+
+    uint32_t GetRootBitSize() const noexcept
+    {
+        return rootBitSize_;
+    }
+
+protected:
+    std::vector<HuffmanTableEntry> table_;
+    uint32_t rootBitSize_ = 0;
+};
+
+// An auxiliary index over a read-only bitmap answering rank (the number of set bits before a bit
+// offset) in constant time and select (the bit offset of the n'th set bit) in near constant time,
+// such as for succinct data structures and compressed indexes. The layout follows Poppy (Zhou,
+// Andersen, Kaminsky, "Space-Efficient, High-Performance Rank & Select Structures on Uncompressed
+// Bit Sequences"):
+//
+//  - Every 2^32 bits, the 64-bit count of all set bits before it.
+//  - Every 2048-bit block, one 64-bit entry holding the 32-bit count of set bits since the last 2^32
+//    boundary, plus the 10-bit counts of the first three of its four 512-bit basic blocks.
+//  - Every 8192 set bits, the 32-bit index of the block holding it, to narrow select's search.
+//
+// That is ~3.1% space overhead for rank, plus at most ~0.4% for select. After the lookups, rank
+// counts at most 7 whole words and one partial word. Select binary searches the blocks between two
+// samples (only a few unless the bitmap is sparse), then scans at most 8 words.
+//
+// The index refers to the bitmap without copying it, so the bitmap must outlive it and not change.
+// Building counts the blocks on threadCount threads (0 = all hardware threads), and the index can
+// be serialized to store next to the bitmap, skipping the build when loaded. Limited to 1TB bitmaps.
+//
+// Example:
+//      RankSelectIndex index;
+//      index.Initialize(bitmap, /*reversedBitsInByte*/ false);
+//      size_t setBitsBefore = index.Rank(1'000'003);
+//      size_t bitOffset = index.Select(42); // Of the 43rd set bit, or bitOffsetNotFound.
+//
+class RankSelectIndex
+{
+public:
+    void Initialize(
+        std::span<uint8_t const> data, // Bitmap referenced (not copied) by the index.
+        bool reversedBitsInByte, // Same bit order semantics as SetSingleBit.
+        uint32_t threadCount = 0
+    );
+
+    // Returns the number of set bits before bitOffset, clamping offsets past the end.
+    size_t Rank(size_t bitOffset) const;
+
+    // Returns the bit offset of the set bit with the given zero-based index, or bitOffsetNotFound if
+    // there are not that many set bits.
+    size_t Select(size_t setBitIndex) const;
+
+    size_t GetBitCount() const noexcept
+    {
+        return data_.size_bytes() * CHAR_BIT;
+    }
+
+    size_t GetSetBitCount() const noexcept
+    {
+        return setBitCount_;
+    }
+
+    // Serializes the index (not the bitmap) in LE byte order, returning false if serialized is
+    // smaller than GetSerializedByteSize().
+    size_t GetSerializedByteSize() const noexcept;
+    bool Serialize(std::span<uint8_t> serialized) const;
+
+    // Loads a serialized index for the same bitmap, returning false if the serialized index is
+    // malformed or was built for a bitmap of a different size.
+    bool Deserialize(std::span<uint8_t const> serialized, std::span<uint8_t const> data);
+
+protected:
+    static constexpr size_t blockBitSize = 2048;
+    static constexpr size_t basicBlockBitSize = 512;
+    static constexpr uint32_t basicBlocksPerBlock = blockBitSize / basicBlockBitSize;
+    static constexpr uint32_t basicBlockCountBitSize = 10;
+    static constexpr size_t blocksPerUpperBlock = (size_t(1) << 32) / blockBitSize;
+    static constexpr size_t selectSampleInterval = 8192;
+
+    // Rank and Select, instantiated with the popcnt instruction when the CPU has it.
+    template <typename PopulationCountFunction>
+    size_t RankImpl(size_t bitOffset, PopulationCountFunction populationCount) const;
+    template <typename PopulationCountFunction>
+    size_t SelectImpl(size_t setBitIndex, PopulationCountFunction populationCount) const;
+    size_t RankPopcnt(size_t bitOffset) const;
+    size_t SelectPopcnt(size_t setBitIndex) const;
+
+    // Counts the set bits of each basic block in the range during Initialize, temporarily storing each
+    // whole block's count in the low 32 bits of its entry. Also instantiated with popcnt.
+    template <typename PopulationCountFunction>
+    void CountBlocksImpl(size_t beginBlockIndex, size_t endBlockIndex, PopulationCountFunction populationCount);
+    void CountBlocksPopcnt(size_t beginBlockIndex, size_t endBlockIndex);
+    void CountBlocks(size_t beginBlockIndex, size_t endBlockIndex);
+
+    // Loads the 64-bit word at wordIndex in bit order (LE, or BE if reversedBitsInByte, so bit
+    // offsets increase downward from the top bit), reading bytes past the end as zero.
+    uint64_t LoadWord(size_t wordIndex) const;
+
+    // Returns the number of set bits before the block.
+    size_t GetBlockRank(size_t blockIndex) const
+    {
+        return static_cast<size_t>(upperCounts_[blockIndex / blocksPerUpperBlock] + uint32_t(blockEntries_[blockIndex]));
+    }
+
+    uint32_t GetBasicBlockCount(uint64_t blockEntry, uint32_t basicBlockIndex) const
+    {
+        return uint32_t(blockEntry >> (32 + basicBlockIndex * basicBlockCountBitSize)) & ((1u << basicBlockCountBitSize) - 1);
+    }
+
+    std::span<uint8_t const> data_;
+    bool reversedBitsInByte_ = false;
+    size_t setBitCount_ = 0;
+    std::vector<uint64_t> upperCounts_; // Per 2^32 bits.
+    std::vector<uint64_t> blockEntries_; // Per block, plus a final partial or empty block.
+    std::vector<uint32_t> selectSamples_; // Block index of every selectSampleInterval'th set bit.
+};
+
+// An owning array of bitSize-bit unsigned elements packed back to back in the given bit order, like a
+// std::vector<uint32_t> that stores exactly ceil(bitSize * size() / 8) bytes, plus
+// bitStringPaddingByteCount bytes if padded so every element access is a single unchecked 64-bit
+// load/store (see PaddedSpan). Elements are accessed with the compile-time specialized
+// ReadBitString/WriteBitString, where operator[] returns a proxy reference like
+// std::vector<bool>::reference, and the random-access iterators work with standard algorithms.
+//
+// Growing allocates exactly the bytes needed rather than growing geometrically like std::vector, so
+// push_back costs O(n) unless capacity was reserved up front. The array is movable but not implicitly
+// copyable, so large arrays are never copied by accident (use Clone). std::copy and std::fill cannot be specialized for the proxy iterators, so use the bulk
+// CopyFrom/CopyTo/Fill methods instead, which go through the array kernels.
+//
+// Example:
+//      PackedArray<13, std::endian::little> samples(sampleCount);
+//      samples[42] = 0x1ABC;
+//      samples.CopyFrom(0, decodedSamples);
+//      std::sort(samples.begin(), samples.end());
+//
+template <size_t bitSize, std::endian endianness, bool padded = false>
+class PackedArray
+{
+    static_assert(bitSize >= 1 && bitSize <= 32, "Bit size must be within 1-32.");
+
+public:
+    // Proxy for a single element, reading it on conversion and writing it on assignment.
+    class ElementReference
+    {
+    public:
+        ElementReference(PackedArray& array, size_t index) noexcept
+        :   array_(&array),
+            index_(index)
+        {
+        }
+
+        ElementReference(ElementReference const& other) = default;
+
+        operator uint32_t() const
+        {
+            return array_->Get(index_);
+        }
+
+        // Const like a reference itself, so the proxy satisfies std::indirectly_writable.
+        ElementReference const& operator=(uint32_t newValue) const
+        {
+            array_->Set(index_, newValue);
+            return *this;
+        }
+
+        // Assigns the element's value (not which element is referenced), like T& would.
+        ElementReference const& operator=(ElementReference const& other) const
+        {
+            return *this = uint32_t(other);
+        }
+
+        friend void swap(ElementReference a, ElementReference b)
+        {
+            const uint32_t aValue = a;
+            a = uint32_t(b);
+            b = aValue;
+        }
+
+    private:
+        PackedArray* array_;
+        size_t index_;
+    };
+
+    template <bool isConst>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = uint32_t;
+        using difference_type = ptrdiff_t;
+        using reference = std::conditional_t<isConst, uint32_t, ElementReference>;
+        using pointer = void;
+        using ArrayType = std::conditional_t<isConst, PackedArray const, PackedArray>;
+
+        Iterator() = default;
+
+        Iterator(ArrayType* array, size_t index) noexcept
+        :   array_(array),
+            index_(index)
+        {
+        }
+
+        // Allow implicit conversion from mutable to const iterators.
+        operator Iterator<true>() const noexcept requires (!isConst)
+        {
+            return {array_, index_};
+        }
+
+        reference operator*() const { return (*array_)[index_]; }
+        reference operator[](difference_type offset) const { return (*array_)[index_ + offset]; }
+
+        Iterator& operator++() noexcept { ++index_; return *this; }
+        Iterator& operator--() noexcept { --index_; return *this; }
+        Iterator operator++(int) noexcept { Iterator previous = *this; ++index_; return previous; }
+        Iterator operator--(int) noexcept { Iterator previous = *this; --index_; return previous; }
+        Iterator& operator+=(difference_type offset) noexcept { index_ += offset; return *this; }
+        Iterator& operator-=(difference_type offset) noexcept { index_ -= offset; return *this; }
+        Iterator operator+(difference_type offset) const noexcept { return {array_, index_ + offset}; }
+        Iterator operator-(difference_type offset) const noexcept { return {array_, index_ - offset}; }
+        friend Iterator operator+(difference_type offset, Iterator const& iterator) noexcept { return iterator + offset; }
+        difference_type operator-(Iterator const& other) const noexcept { return difference_type(index_ - other.index_); }
+
+        bool operator==(Iterator const& other) const noexcept { return index_ == other.index_; }
+        auto operator<=>(Iterator const& other) const noexcept { return index_ <=> other.index_; }
+
+    private:
+        ArrayType* array_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    using value_type = uint32_t;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using reference = ElementReference;
+    using const_reference = uint32_t;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    static constexpr size_t paddingByteCount = padded ? bitStringPaddingByteCount : 0;
+
+    // Returns the bytes needed to hold elementCount elements, excluding padding.
+    static constexpr size_t GetByteSize(size_t elementCount) noexcept
+    {
+        return (elementCount * bitSize + CHAR_BIT - 1) / CHAR_BIT;
+    }
+
+    PackedArray() = default;
+
+    explicit PackedArray(size_t size)
+    {
+        resize(size);
+    }
+
+    PackedArray(size_t size, uint32_t value)
+    {
+        resize(size);
+        Fill(value);
+    }
+
+    PackedArray(PackedArray&& other) noexcept
+    :   bytes_(std::move(other.bytes_)),
+        size_(std::exchange(other.size_, 0))
+    {
+        other.bytes_.clear();
+    }
+
+    PackedArray& operator=(PackedArray&& other) noexcept
+    {
+        bytes_ = std::move(other.bytes_);
+        size_ = std::exchange(other.size_, 0);
+        other.bytes_.clear();
+        return *this;
+    }
+
+    PackedArray(PackedArray const&) = delete;
+    PackedArray& operator=(PackedArray const&) = delete;
+
+    PackedArray Clone() const
+    {
+        PackedArray copy;
+        copy.bytes_ = bytes_;
+        copy.size_ = size_;
+        return copy;
+    }
+
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    size_t size_bytes() const noexcept { return GetByteSize(size_); }
+    uint8_t* data() noexcept { return bytes_.data(); }
+    uint8_t const* data() const noexcept { return bytes_.data(); }
+
+    size_t capacity() const noexcept
+    {
+        return (bytes_.capacity() > paddingByteCount) ? (bytes_.capacity() - paddingByteCount) * CHAR_BIT / bitSize : 0;
+    }
+
+    void reserve(size_t newCapacity)
+    {
+        bytes_.reserve(GetByteSize(newCapacity) + paddingByteCount);
+    }
+
+    void shrink_to_fit()
+    {
+        bytes_.shrink_to_fit();
+    }
+
+    // New elements are 0.
+    void resize(size_t newSize)
+    {
+        const size_t oldByteSize = GetByteSize(size_);
+        const size_t newByteSize = GetByteSize(newSize);
+        if (newSize < size_)
+        {
+            // Clear the removed elements sharing the last byte, so growing again reads them as 0.
+            ClearBitRange(std::span<uint8_t>(bytes_.data(), newByteSize), newSize * bitSize, CHAR_BIT, endianness == std::endian::big);
+        }
+        const size_t newStorageByteSize = newByteSize + paddingByteCount;
+        if (newStorageByteSize > bytes_.capacity())
+        {
+            bytes_.reserve(newStorageByteSize); // Exactly, rather than letting resize grow geometrically.
+        }
+        bytes_.resize(newStorageByteSize);
+        if (newByteSize > oldByteSize && !bytes_.empty())
+        {
+            // The old padding bytes may still hold removed elements from shrinking.
+            const size_t staleByteSize = std::min(newByteSize, oldByteSize + paddingByteCount) - oldByteSize;
+            memset(bytes_.data() + oldByteSize, 0, staleByteSize);
+        }
+        size_ = newSize;
+    }
+
+    void clear() noexcept
+    {
+        bytes_.clear();
+        size_ = 0;
+    }
+
+    // Reallocates unless capacity was reserved, since growth is exact.
+    void push_back(uint32_t value)
+    {
+        resize(size_ + 1);
+        Set(size_ - 1, value);
+    }
+
+    ElementReference operator[](size_t index) noexcept
+    {
+        return {*this, index};
+    }
+
+    uint32_t operator[](size_t index) const
+    {
+        return Get(index);
+    }
+
+    uint32_t Get(size_t index) const
+    {
+        assert(index < size_);
+        if constexpr (padded)
+        {
+            return ReadBitString<bitSize, endianness>(GetPaddedSpan(), index * bitSize);
+        }
+        else
+        {
+            return ReadBitString<bitSize, endianness>(GetSpan(), index * bitSize);
+        }
+    }
+
+    // Values are masked to bitSize.
+    void Set(size_t index, uint32_t newValue)
+    {
+        assert(index < size_);
+        newValue &= uint32_t((uint64_t(1) << bitSize) - 1); // The general WriteBitString near the end does not mask.
+        if constexpr (padded)
+        {
+            WriteBitString<bitSize, endianness>(GetPaddedSpan(), index * bitSize, newValue);
+        }
+        else
+        {
+            WriteBitString<bitSize, endianness>(GetSpan(), index * bitSize, newValue);
+        }
+    }
+
+    iterator begin() noexcept { return {this, 0}; }
+    iterator end() noexcept { return {this, size_}; }
+    const_iterator begin() const noexcept { return {this, 0}; }
+    const_iterator end() const noexcept { return {this, size_}; }
+    const_iterator cbegin() const noexcept { return {this, 0}; }
+    const_iterator cend() const noexcept { return {this, size_}; }
+
+    // Sets every element to value. Every 8 elements span exactly bitSize bytes, so the first 8 are
+    // written and their bytes replicated with memcpy, then the final partial group is written.
+    void Fill(uint32_t value)
+    {
+        uint32_t values[CHAR_BIT];
+        std::fill(std::begin(values), std::end(values), value);
+        const std::span<uint8_t> bytes = GetSpan();
+        const size_t groupCount = size_ / CHAR_BIT;
+        if (groupCount > 0)
+        {
+            WriteBitStringArray(bytes, 0, bitSize, endianness, values);
+            const size_t groupedByteSize = groupCount * bitSize;
+            for (size_t filledByteSize = bitSize; filledByteSize < groupedByteSize; )
+            {
+                const size_t copyByteSize = std::min(filledByteSize, groupedByteSize - filledByteSize);
+                memcpy(bytes.data() + filledByteSize, bytes.data(), copyByteSize);
+                filledByteSize += copyByteSize;
+            }
+        }
+        WriteBitStringArray(bytes, groupCount * CHAR_BIT * bitSize, bitSize, endianness, std::span<uint32_t const>(values, size_ % CHAR_BIT));
+    }
+
+    // Writes values to the elements starting at index, which must all be within the array.
+    void CopyFrom(size_t index, std::span<uint32_t const> values)
+    {
+        assert(index <= size_ && values.size() <= size_ - index);
+        WriteBitStringArray(GetSpan(), index * bitSize, bitSize, endianness, values);
+    }
+
+    // Reads the elements starting at index into values, which must all be within the array.
+    void CopyTo(size_t index, std::span<uint32_t> values) const
+    {
+        assert(index <= size_ && values.size() <= size_ - index);
+        ReadBitStringArray(GetSpan(), index * bitSize, bitSize, endianness, values);
+    }
+
+protected:
+    std::span<uint8_t> GetSpan() noexcept
+    {
+        return {bytes_.data(), GetByteSize(size_)};
+    }
+
+    std::span<uint8_t const> GetSpan() const noexcept
+    {
+        return {bytes_.data(), GetByteSize(size_)};
+    }
+
+    PaddedSpan<uint8_t> GetPaddedSpan() noexcept
+    {
+        return {bytes_, GetByteSize(size_)};
+    }
+
+    PaddedSpan<uint8_t const> GetPaddedSpan() const noexcept
+    {
+        return {bytes_, GetByteSize(size_)};
+    }
+
+    std::vector<uint8_t> bytes_; // Logical bytes plus paddingByteCount.
+    size_t size_ = 0;
+};
@@ -29,13 +29,167 @@
 //               as bytes: 60,FB,21,09,08
 //      32-bit BE data @5: 3.141593
 //               as bytes: 02,02,48,7E,D8
+//
+//  Test reading/writing 64-bit fields at unaligned offsets:
+//      64-bit LE data @5: 3.141592653589793
+//               as bytes: 00,A3,85,88,6A,3F,24,01,08
+//      64-bit BE data @5: 3.141592653589793
+//               as bytes: 02,00,49,0F,DA,A2,21,68,C0
+//      48-bit LE data @3: 123456789ABC
+//      48-bit BE data @3: 123456789ABC
+//
+//  Test bulk array reading at unaligned offset:
+//      LE 19-bit data @3: 0,1,2,3,4,5,6,7,8,9,A,B,C,D,E,F,10,11,12,13,14,15,16,17,18,19,1A,1B,1C,1D,1E,1F,20,21,22,23,24,25,26,27
+//      BE 19-bit data @3: 0,1,2,3,4,5,6,7,8,9,A,B,C,D,E,F,10,11,12,13,14,15,16,17,18,19,1A,1B,1C,1D,1E,1F,20,21,22,23,24,25,26,27
+//      Matches per-element reads: LE=yes, BE=yes
+//
+//  Test bulk array writing at unaligned offset between existing data:
+//      LE 19-bit data @3: 05,00,40,00,00,04,00,30,00,00,02,00,14,00,C0,00,00,07,00,40,00,40,02,00,14,00
+//      BE 19-bit data @3: A0,00,00,00,00,80,00,20,00,06,00,01,00,00,28,00,06,00,00,E0,00,20,00,04,00,A5
+//      Matches per-element writes: LE=yes, BE=yes
+//
+//  Test bulk array round trip of every bit width (1-32):
+//      LE 100 elements @0: ok
+//      BE 100 elements @0: ok
+//      LE 100 elements @5: ok
+//      BE 100 elements @5: ok
+//      LE 100 elements @8: ok
+//      BE 100 elements @8: ok
+//
+//  Test compile-time specialized reading/writing:
+//      LE 12-bit data [3]: CBA
+//      BE 12-bit data [3]: CBA
+//      32-bit LE data @5: 3.141593
+//               as bytes: 60,FB,21,09,08,00,00,00,00
+//      32-bit BE data @5: 3.141593
+//               as bytes: 02,02,48,7E,D8,00,00,00,00
+//
+//  Test reading/writing padded buffers:
+//      LE 12-bit data [3]: CBA
+//      BE 12-bit data [3]: CBA
+//      64-bit LE data @5: 3.141592653589793
+//               as bytes: 00,A3,85,88,6A,3F,24,01,08
+//      64-bit BE data @5: 3.141592653589793
+//               as bytes: 02,00,49,0F,DA,A2,21,68,C0
+//
+//  Test sequential bit reader:
+//      LE 13-bit data: 0,1,2,3,4,5,6,7,8,9,A,B,C,D,E,F
+//      BE 13-bit data: 0,1,2,3,4,5,6,7,8,9,A,B,C,D,E,F
+//      LE peek/skip/align: peek=3, skip 13 -> 4, align -> offset 56, read 8 = 0
+//      BE peek/skip/align: peek=3, skip 13 -> 4, align -> offset 56, read 8 = 2
+//      LE read past end: 0, remaining bits: 0
+//
+//  Test sequential bit writer:
+//      LE 13-bit data: 00,20,00,08,80,01,40,00,0A,80,01,38,00,08,20,01,28,80,05,C0,00,1A,80,03,78,00
+//      BE 13-bit data: 00,00,00,40,04,00,30,02,00,14,00,C0,07,00,40,02,40,14,00,B0,06,00,34,01,C0,0F
+//      LE growable sink: 3 bytes, EF,E3,0F
+//      BE growable sink: 3 bytes, 27,46,80
+//
+//  Test variable-length codes:
+//      ue(v): 0,1,2,3,7,FE
+//      se(v): 0,1,-1,2,-2, bit offset 51
+//      Rice k=2: 1,6,D, unary until end: 51 zeros, bit offset 64
+//
+//  Test Huffman decoding:
+//      LE symbols: 5,0,2,4,7,6, bit offset 19
+//      BE symbols: 5,0,2,4,7,6, bit offset 19
+//      BE incomplete code: 4 symbols before invalid code, next symbol FFFFFFFF, bit offset 11
+//      over-subscribed code valid: 0
+//
+//  Test varints:
+//      encoded 25 bytes: 00,01,7F,80,01,AC,02,80,80,01,FF,FF,FF,FF,0F,FF,FF,FF,FF,FF,FF,FF,FF,FF,01
+//      decoded 8 values: 0,1,7F,80,12C,4000,FFFFFFFF,FFFFFFFFFFFFFFFF
+//      LE @3: 60,15,28,00, read 300,5, bit offset 27
+//      BE @3: 15,80,40,A0, read 300,5, bit offset 27
+//
+//  Test copying bit ranges:
+//      LE concatenated: FF,3F,60,A4,E8,2C,71,B5,F9,BD,4A,15,00
+//      LE moved back:   01,23,45,67,89,AB,CD,EF,55,AA,4A,15,00
+//      BE concatenated: FF,F8,09,1A,2B,3C,4D,5E,6F,7A,AD,50,00
+//      BE moved back:   01,23,45,67,89,AB,CD,EF,55,AA,AD,50,00
+//
+//  Test bit range operations:
+//      normal   set 3-32:        F8,FF,FF,FF,01,00
+//      normal   clear 12-17:     F8,0F,FC,FF,01,00
+//      normal   flip 6-41:       38,F0,03,00,FE,03
+//      normal   fill 20-43 (5A): 38,F0,53,5A,5A,0A
+//      reversed set 3-32:        1F,FF,FF,FF,80,00
+//      reversed clear 12-17:     1F,F0,3F,FF,80,00
+//      reversed flip 6-41:       1C,0F,C0,00,7F,C0
+//      reversed fill 20-43 (5A): 1C,0F,CA,5A,5A,50
+//
+//  Test single bit operations:
+//      test and set 9,30,2,9,17,100: 4 newly set, was set 0,0,0,1,0,0, bytes 04,02,02,40
+//      toggle 1,2,2,3,24,31: 0E,02,02,C1
+//      clear 30, toggle reversed 0: 8E,02,02,81, test 7 = 1, test reversed 7 = 0
+//
+//  Test counting bits:
+//      bytes F0,0F,FF,01 normal 2-21: 14, reversed 2-21: 12, reversed 30-31: 1
+//      1000 bytes (i*37) all: 3996, 13-7900: 3943, past end: 4
+//
+//  Test rank/select index:
+//      set bits: 3334, rank 0/1/3000/10000/16000: 0,1,1000,1334,3334
+//      select 0/1/1333/1334/3333/3334: 0,3,3999,10002,15999,-1
+//      serialized 100 bytes, loaded: 1, select 2000: 12000
+//      20 samples swapped loaded: 0, bad block rank loaded: 0, select 2000: 12000
+//
+//  Test finding bits:
+//      set bits: 5 700 4093 7999, and 1997 in 1000-2999 summing to 3994497
+//      next set from 6/701/3000: 700,1000,4093, next clear from 1000/1503: 1500,3000
+//      prev set from 999/4092/end: 700,2999,7999, next set after last: -1
+//      reversed set bits: 18,72, prev from 71: 18
+//
+//  Test combining bit ranges:
+//      LE and:    F8,03,84,01,28,01,60,02,40,01
+//      LE or:     F8,FF,FF,9B,FE,D7,FD,9F,FC,01
+//      LE xor:    00,FC,7B,9A,D6,D6,9D,9D,BC,00
+//      LE andnot: 00,FC,03,98,02,D4,01,9C,00,00
+//      BE xor in place: CF,3F,30,F3,6A,6A,FC,FC,BE,BE
+//
+//  Test shifting bits:
+//      BE payload after 5-bit header: 12,34,56,78,9A
+//      LE in place by -12: 00,20,41,63,85,A7,C9,EB
+//      LE in place by 12:  12,34,56,78,9A,BC,0E,00
+//
+//  Test converting endianness:
+//      13-bit BE->LE: BC,7A,24,FC,7F,00,00
+//      13-bit LE values: 1ABC,123,1FFF,0
+//      4-bit in place: 21,43,65,87
+//      16-bit in place: 34,12,78,56,BC,9A
+//
+//  Test reversing bits:
+//      LSB-first to MSB-first: C0,40
+//      Whole range reversed: 1E,6A,2C,48
+//      LE bits 4-19 reversed: 62,2C,58,78
+//      BE bits 3-8 reversed: 04,B4,56,78
+//
+//  Test packed array:
+//      Sorted 13-bit BE (9 bytes, capacity 5): 0,42,123,1ABC,1FFF
+//      Bytes: 00,00,10,82,47,AB,CF,FF,80
+//      Moved-from size: 0, cloned: 0,42,123,1ABC,1FFF, filled: 555,555
+//
+//  Test backward bit reader:
+//      LE fields from end: 123,F00D5,1,DEADBEEF,55,1ABC,5, remaining bits: 0, read before front: 0
+//      BE fields from end: 123,F00D5,1,DEADBEEF,55,1ABC,5, remaining bits: 0, read before front: 0
+//
+//  Test gathering/scattering multiple bit fields:
+//      GatherBits(0123456789ABCDEF, FF0000F00F0000FF): 169EF
+//      ScatterBits(169EF, FF0000F00F0000FF): 01000060090000EF
+//      LE 24-bit fields @3: D5A
+//               as bytes: 50,28,80,06
+//      BE 24-bit fields @3: D5A
+//               as bytes: 1A,00,A1,40
+//      LE 8-bit window @4 with mask FF0F: F0,00
 
 // Needs C++20.
 #include <climits>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <bit> // std::endian
+#include <algorithm> // std::sort
 #include <span>
+#include <vector>
 #include <assert.h>
 
 #include "BitString.h"
@@ -48,6 +202,14 @@ void PrintBytes(std::span<uint8_t const> data)
     }
 }
 
+void PrintValues(std::span<uint32_t const> values)
+{
+    for (size_t i = 0, size = values.size(); i < size; ++i)
+    {
+        printf((i == 0) ? "%X" : ",%X", values[i]);
+    }
+}
+
 void PrintBitStringElements(
     std::span<uint8_t const> data,
     size_t bitOffset,
@@ -99,14 +261,11 @@ int main()
         constexpr size_t elementCount = sizeof(elementsLe) * CHAR_BIT / elementBitSize;
 
         // Initialize with simple test pattern of alternating 0 runs and 1 runs.
-        for (size_t bitOffset = 0, bitCount = sizeof(elementsLe) * CHAR_BIT; bitOffset < bitCount; ++bitOffset)
+        for (size_t bitOffset = elementBitSize, bitCount = sizeof(elementsLe) * CHAR_BIT; bitOffset < bitCount; bitOffset += elementBitSize * 2)
         {
             static_assert(sizeof(elementsBe) == sizeof(elementsLe));
-            if ((bitOffset / elementBitSize) & 1)
-            {
-                SetSingleBit(elementsLe, bitOffset, false);
-                SetSingleBit(elementsBe, bitOffset, true);
-            }
+            SetBitRange(elementsLe, bitOffset, elementBitSize, false);
+            SetBitRange(elementsBe, bitOffset, elementBitSize, true);
         }
 
         PrintLeAndBeBitStringElements(elementsLe, elementsBe, 0, elementBitSize, elementCount);
@@ -131,13 +290,15 @@ int main()
         constexpr size_t elementBitSize = 13;
         constexpr size_t elementCount = sizeof(elementsLe) * CHAR_BIT / elementBitSize;
 
-        // Initialize with simple test pattern of alternating 0 runs and 1 runs.
-        for (size_t bitOffset = 0, bitCount = sizeof(elementsLe) * CHAR_BIT; bitOffset < bitCount; bitOffset += elementBitSize)
+        uint32_t values[elementCount];
+
+        // Initialize with simple increasing sequence.
+        for (size_t i = 0; i < elementCount; ++i)
         {
-            uint32_t value = uint32_t(bitOffset / elementBitSize);
-            WriteBitString(/*inout*/ elementsLe, bitOffset, elementBitSize, std::endian::little, value);
-            WriteBitString(/*inout*/ elementsBe, bitOffset, elementBitSize, std::endian::big,    value);
+            values[i] = uint32_t(i);
         }
+        WriteBitStringArray(/*inout*/ elementsLe, 0, elementBitSize, std::endian::little, values);
+        WriteBitStringArray(/*inout*/ elementsBe, 0, elementBitSize, std::endian::big,    values);
 
         PrintLeAndBeBitStringElements(elementsLe, elementsBe, 0, elementBitSize, elementCount);
     }
@@ -211,4 +372,732 @@ int main()
         printf("             as bytes: "); PrintBytes(bufferBe); printf("\n");
     }
     printf("\n");
+
+    printf("Test reading/writing 64-bit fields at unaligned offsets:\n");
+    {
+        uint8_t bufferLe[sizeof(double) + 1] = {};
+        uint8_t bufferBe[sizeof(double) + 1] = {};
+        constexpr size_t bitOffset = 5;
+        constexpr size_t bitSize = sizeof(double) * CHAR_BIT;
+        constexpr uint64_t piValue = std::bit_cast<uint64_t>(3.14159265358979323846);
+        double readbackValue;
+
+        WriteBitString64(bufferLe, bitOffset, bitSize, std::endian::little, piValue);
+        WriteBitString64(bufferBe, bitOffset, bitSize, std::endian::big,    piValue);
+
+        readbackValue = std::bit_cast<double>(ReadBitString64(bufferLe, bitOffset, bitSize, std::endian::little));
+        printf("    %zu-bit LE data @%zu: %.15f\n", bitSize, bitOffset, readbackValue);
+        printf("             as bytes: "); PrintBytes(bufferLe); printf("\n");
+
+        readbackValue = std::bit_cast<double>(ReadBitString64(bufferBe, bitOffset, bitSize, std::endian::big));
+        printf("    %zu-bit BE data @%zu: %.15f\n", bitSize, bitOffset, readbackValue);
+        printf("             as bytes: "); PrintBytes(bufferBe); printf("\n");
+
+        // A 48-bit MAC address between other fields, which must remain intact.
+        uint8_t macLe[8];
+        uint8_t macBe[8];
+        memset(macLe, 0xFF, sizeof(macLe));
+        memset(macBe, 0xFF, sizeof(macBe));
+        constexpr uint64_t macValue = 0x123456789ABC;
+        WriteBitString64(macLe, 3, 48, std::endian::little, macValue);
+        WriteBitString64(macBe, 3, 48, std::endian::big,    macValue);
+        printf("    48-bit LE data @3: %llX\n", (unsigned long long)ReadBitString64(macLe, 3, 48, std::endian::little));
+        printf("    48-bit BE data @3: %llX\n", (unsigned long long)ReadBitString64(macBe, 3, 48, std::endian::big));
+    }
+    printf("\n");
+
+    printf("Test bulk array reading at unaligned offset:\n");
+    {
+        constexpr size_t elementBitSize = 19;
+        constexpr size_t elementCount = 40;
+        constexpr size_t bitOffset = 3;
+        uint8_t elementsLe[(bitOffset + elementBitSize * elementCount + 7) / CHAR_BIT] = {};
+        uint8_t elementsBe[(bitOffset + elementBitSize * elementCount + 7) / CHAR_BIT] = {};
+        uint32_t valuesLe[elementCount];
+        uint32_t valuesBe[elementCount];
+
+        for (size_t i = 0; i < elementCount; ++i)
+        {
+            WriteBitString(/*inout*/ elementsLe, bitOffset + i * elementBitSize, elementBitSize, std::endian::little, uint32_t(i));
+            WriteBitString(/*inout*/ elementsBe, bitOffset + i * elementBitSize, elementBitSize, std::endian::big,    uint32_t(i));
+        }
+
+        ReadBitStringArray(elementsLe, bitOffset, elementBitSize, std::endian::little, valuesLe);
+        ReadBitStringArray(elementsBe, bitOffset, elementBitSize, std::endian::big,    valuesBe);
+
+        bool matchesLe = true, matchesBe = true;
+        for (size_t i = 0; i < elementCount; ++i)
+        {
+            matchesLe &= (valuesLe[i] == ReadBitString(elementsLe, bitOffset + i * elementBitSize, elementBitSize, std::endian::little));
+            matchesBe &= (valuesBe[i] == ReadBitString(elementsBe, bitOffset + i * elementBitSize, elementBitSize, std::endian::big));
+        }
+
+        printf("    LE %zu-bit data @%zu: ", elementBitSize, bitOffset); PrintValues(valuesLe); printf("\n");
+        printf("    BE %zu-bit data @%zu: ", elementBitSize, bitOffset); PrintValues(valuesBe); printf("\n");
+        printf("    Matches per-element reads: LE=%s, BE=%s\n", matchesLe ? "yes" : "no", matchesBe ? "yes" : "no");
+    }
+    printf("\n");
+
+    printf("Test bulk array writing at unaligned offset between existing data:\n");
+    {
+        constexpr size_t elementBitSize = 19;
+        constexpr size_t elementCount = 12; // The last one only partially fits and is clipped.
+        constexpr size_t bitOffset = 3;
+        uint8_t elementsLe[26], elementsBe[26], expectedLe[26], expectedBe[26];
+        memset(elementsLe, 0xA5, sizeof(elementsLe));
+        memset(elementsBe, 0xA5, sizeof(elementsBe));
+        memset(expectedLe, 0xA5, sizeof(expectedLe));
+        memset(expectedBe, 0xA5, sizeof(expectedBe));
+        uint32_t values[elementCount];
+
+        for (size_t i = 0; i < elementCount; ++i)
+        {
+            values[i] = uint32_t(i);
+            WriteBitString(/*inout*/ expectedLe, bitOffset + i * elementBitSize, elementBitSize, std::endian::little, values[i]);
+            WriteBitString(/*inout*/ expectedBe, bitOffset + i * elementBitSize, elementBitSize, std::endian::big,    values[i]);
+        }
+
+        WriteBitStringArray(/*inout*/ elementsLe, bitOffset, elementBitSize, std::endian::little, values);
+        WriteBitStringArray(/*inout*/ elementsBe, bitOffset, elementBitSize, std::endian::big,    values);
+
+        const bool matchesLe = memcmp(elementsLe, expectedLe, sizeof(elementsLe)) == 0;
+        const bool matchesBe = memcmp(elementsBe, expectedBe, sizeof(elementsBe)) == 0;
+
+        printf("    LE %zu-bit data @%zu: ", elementBitSize, bitOffset); PrintBytes(elementsLe); printf("\n");
+        printf("    BE %zu-bit data @%zu: ", elementBitSize, bitOffset); PrintBytes(elementsBe); printf("\n");
+        printf("    Matches per-element writes: LE=%s, BE=%s\n", matchesLe ? "yes" : "no", matchesBe ? "yes" : "no");
+    }
+    printf("\n");
+
+    printf("Test bulk array round trip of every bit width (1-32):\n");
+    {
+        constexpr size_t elementCount = 100; // Multiple whole 32-element blocks plus a partial one.
+        uint8_t elements[(32 * elementCount + 8) / CHAR_BIT + 1];
+        uint32_t values[elementCount];
+        uint32_t readbackValues[elementCount];
+
+        // Offset 5 exercises the non-byte-aligned AVX2 paths, including the 64-bit lanes for 25-32 bits.
+        for (size_t bitOffset : {0, 5, 8})
+        {
+            for (std::endian endianness : {std::endian::little, std::endian::big})
+            {
+                bool matches = true;
+                for (size_t bitSize = 1; bitSize <= 32; ++bitSize)
+                {
+                    const uint32_t valueMask = uint32_t((uint64_t(1) << bitSize) - 1);
+                    for (size_t i = 0; i < elementCount; ++i)
+                    {
+                        values[i] = uint32_t(i * 0x9E3779B9u) & valueMask;
+                    }
+
+                    memset(elements, 0, sizeof(elements));
+                    WriteBitStringArray(/*inout*/ elements, bitOffset, bitSize, endianness, values);
+                    ReadBitStringArray(elements, bitOffset, bitSize, endianness, readbackValues);
+
+                    for (size_t i = 0; i < elementCount; ++i)
+                    {
+                        matches &= (readbackValues[i] == values[i]);
+                        matches &= (ReadBitString(elements, bitOffset + i * bitSize, bitSize, endianness) == values[i]);
+                    }
+                }
+                printf("    %s %zu elements @%zu: %s\n", (endianness == std::endian::little) ? "LE" : "BE", elementCount, bitOffset, matches ? "ok" : "FAILED");
+            }
+        }
+    }
+    printf("\n");
+
+    printf("Test compile-time specialized reading/writing:\n");
+    {
+        const uint8_t elementsLe[] = {0x21, 0x43, 0x65, 0x87, 0xA9, 0xCB, 0x00, 0x00, 0x00, 0x00, 0x00};
+        const uint8_t elementsBe[] = {0x32, 0x16, 0x54, 0x98, 0x7C, 0xBA, 0x00, 0x00, 0x00, 0x00, 0x00};
+        printf("    LE 12-bit data [3]: %X\n", ReadBitString<12, std::endian::little>(elementsLe, 3 * 12));
+        printf("    BE 12-bit data [3]: %X\n", ReadBitString<12, std::endian::big>(elementsBe, 3 * 12));
+
+        // Padded enough for the word-sized fast path (versus the float test above).
+        uint8_t bufferLe[sizeof(uint64_t) + 1] = {};
+        uint8_t bufferBe[sizeof(uint64_t) + 1] = {};
+        constexpr size_t bitOffset = 5;
+        constexpr uint32_t piValue = std::bit_cast<uint32_t>(3.14159265358979323846f);
+
+        WriteBitString<32, std::endian::little>(bufferLe, bitOffset, piValue);
+        WriteBitString<32, std::endian::big>(bufferBe, bitOffset, piValue);
+
+        printf("    32-bit LE data @%zu: %f\n", bitOffset, std::bit_cast<float>(ReadBitString<32, std::endian::little>(bufferLe, bitOffset)));
+        printf("             as bytes: "); PrintBytes(bufferLe); printf("\n");
+        printf("    32-bit BE data @%zu: %f\n", bitOffset, std::bit_cast<float>(ReadBitString<32, std::endian::big>(bufferBe, bitOffset)));
+        printf("             as bytes: "); PrintBytes(bufferBe); printf("\n");
+    }
+    printf("\n");
+
+    printf("Test reading/writing padded buffers:\n");
+    {
+        // Only the first 6 bytes are logical data, with the rest being padding.
+        const uint8_t elementsLe[6 + bitStringPaddingByteCount] = {0x21, 0x43, 0x65, 0x87, 0xA9, 0xCB};
+        const uint8_t elementsBe[6 + bitStringPaddingByteCount] = {0x32, 0x16, 0x54, 0x98, 0x7C, 0xBA};
+        PaddedSpan<uint8_t const> paddedLe(elementsLe, 6);
+        PaddedSpan<uint8_t const> paddedBe(elementsBe, 6);
+        printf("    LE 12-bit data [3]: %X\n", ReadBitString(paddedLe, 3 * 12, 12, std::endian::little));
+        printf("    BE 12-bit data [3]: %X\n", ReadBitString(paddedBe, 3 * 12, 12, std::endian::big));
+
+        uint8_t bufferLe[sizeof(double) + 1 + bitStringPaddingByteCount] = {};
+        uint8_t bufferBe[sizeof(double) + 1 + bitStringPaddingByteCount] = {};
+        PaddedSpan<uint8_t> paddedBufferLe(bufferLe, sizeof(double) + 1);
+        PaddedSpan<uint8_t> paddedBufferBe(bufferBe, sizeof(double) + 1);
+        constexpr size_t bitOffset = 5;
+        constexpr size_t bitSize = sizeof(double) * CHAR_BIT;
+        constexpr uint64_t piValue = std::bit_cast<uint64_t>(3.14159265358979323846);
+
+        WriteBitString64(paddedBufferLe, bitOffset, bitSize, std::endian::little, piValue);
+        WriteBitString64(paddedBufferBe, bitOffset, bitSize, std::endian::big,    piValue);
+
+        printf("    %zu-bit LE data @%zu: %.15f\n", bitSize, bitOffset, std::bit_cast<double>(ReadBitString64(paddedBufferLe, bitOffset, bitSize, std::endian::little)));
+        printf("             as bytes: "); PrintBytes(paddedBufferLe.logical_span()); printf("\n");
+        printf("    %zu-bit BE data @%zu: %.15f\n", bitSize, bitOffset, std::bit_cast<double>(ReadBitString64(paddedBufferBe, bitOffset, bitSize, std::endian::big)));
+        printf("             as bytes: "); PrintBytes(paddedBufferBe.logical_span()); printf("\n");
+    }
+    printf("\n");
+
+    printf("Test sequential bit reader:\n");
+    {
+        uint8_t elementsLe[26] = {};
+        uint8_t elementsBe[26] = {};
+        constexpr size_t elementBitSize = 13;
+        constexpr size_t elementCount = sizeof(elementsLe) * CHAR_BIT / elementBitSize;
+        for (size_t i = 0; i < elementCount; ++i)
+        {
+            WriteBitString(/*inout*/ elementsLe, i * elementBitSize, elementBitSize, std::endian::little, uint32_t(i));
+            WriteBitString(/*inout*/ elementsBe, i * elementBitSize, elementBitSize, std::endian::big,    uint32_t(i));
+        }
+
+        BitReader<std::endian::little> readerLe(elementsLe);
+        BitReader<std::endian::big> readerBe(elementsBe);
+        printf("    LE %zu-bit data: ", elementBitSize);
+        for (size_t i = 0; i < elementCount; ++i)
+        {
+            printf((i == 0) ? "%X" : ",%X", readerLe.Read(elementBitSize));
+        }
+        printf("\n");
+        printf("    BE %zu-bit data: ", elementBitSize);
+        for (size_t i = 0; i < elementCount; ++i)
+        {
+            printf((i == 0) ? "%X" : ",%X", readerBe.Read(elementBitSize));
+        }
+        printf("\n");
+
+        auto testPeekSkipAlign = [=](auto& reader, char const* endiannessName)
+        {
+            reader.Seek(3 * elementBitSize);
+            const uint32_t peekedValue = reader.Peek(elementBitSize);
+            reader.Skip(elementBitSize);
+            const uint32_t nextValue = reader.Peek(elementBitSize);
+            reader.AlignToByte();
+            const size_t alignedBitOffset = reader.GetBitOffset();
+            printf(
+                "    %s peek/skip/align: peek=%X, skip %zu -> %X, align -> offset %zu, read 8 = %X\n",
+                endiannessName, peekedValue, elementBitSize, nextValue, alignedBitOffset, reader.Read(8)
+            );
+        };
+        testPeekSkipAlign(readerLe, "LE");
+        testPeekSkipAlign(readerBe, "BE");
+
+        readerLe.Seek(sizeof(elementsLe) * CHAR_BIT);
+        printf("    LE read past end: %X, remaining bits: %zu\n", readerLe.Read(32), readerLe.GetRemainingBitCount());
+    }
+    printf("\n");
+
+    printf("Test sequential bit writer:\n");
+    {
+        // Should match the increasing sequence written by WriteBitStringArray above.
+        uint8_t elementsLe[26];
+        uint8_t elementsBe[26];
+        memset(elementsLe, 0xA5, sizeof(elementsLe)); // Overwritten entirely.
+        memset(elementsBe, 0xA5, sizeof(elementsBe));
+        constexpr size_t elementBitSize = 13;
+        constexpr size_t elementCount = sizeof(elementsLe) * CHAR_BIT / elementBitSize;
+
+        BitWriter<std::endian::little> writerLe(elementsLe);
+        BitWriter<std::endian::big> writerBe(elementsBe);
+        for (size_t i = 0; i < elementCount; ++i)
+        {
+            writerLe.Write(elementBitSize, uint32_t(i));
+            writerBe.Write(elementBitSize, uint32_t(i));
+        }
+        writerLe.Flush();
+        writerBe.Flush();
+
+        printf("    LE %zu-bit data: ", elementBitSize); PrintBytes(elementsLe); printf("\n");
+        printf("    BE %zu-bit data: ", elementBitSize); PrintBytes(elementsBe); printf("\n");
+
+        // Fields of mixed sizes into a growable buffer, with the last byte only partially filled.
+        std::vector<uint8_t> sinkLe;
+        std::vector<uint8_t> sinkBe;
+        BitWriter<std::endian::little> sinkWriterLe(sinkLe);
+        BitWriter<std::endian::big> sinkWriterBe(sinkBe);
+        sinkWriterLe.Write(3, 0x7);  sinkWriterLe.Write(2, 0x1);  sinkWriterLe.Write(15, 0x7F1F);
+        sinkWriterBe.Write(3, 0x1);  sinkWriterBe.Write(2, 0x0);  sinkWriterBe.Write(15, 0x7468);
+        sinkWriterLe.Flush();
+        sinkWriterBe.Flush();
+
+        printf("    LE growable sink: %zu bytes, ", sinkLe.size()); PrintBytes(sinkLe); printf("\n");
+        printf("    BE growable sink: %zu bytes, ", sinkBe.size()); PrintBytes(sinkBe); printf("\n");
+    }
+    printf("\n");
+
+    printf("Test variable-length codes:\n");
+    {
+        // ue(v) codes for 0,1,2,3,7,254 then se(v) codes for 0,1,-1,2,-2, as in an H.264 header.
+        uint8_t codes[] = {0xA6, 0x41, 0x00, 0x3F, 0xE9, 0x90, 0xA0, 0x00};
+        uint32_t ueValues[6] = {};
+        int32_t seValues[5] = {};
+        BitReader<std::endian::big> reader(codes);
+        reader.ReadExpGolombArray(ueValues);
+        reader.ReadSignedExpGolombArray(seValues);
+        printf("    ue(v): "); PrintValues(ueValues); printf("\n");
+        printf("    se(v): ");
+        for (size_t i = 0; i < std::size(seValues); ++i)
+        {
+            printf((i == 0) ? "%d" : ",%d", seValues[i]);
+        }
+        printf(", bit offset %zu\n", reader.GetBitOffset());
+
+        // Rice k=2 codes for 1,6,13 (quotients 0,1,3), then a long unary run reaching the end of data.
+        uint8_t riceCodes[] = {0xAC, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        BitReader<std::endian::big> riceReader(riceCodes);
+        uint32_t riceValues[3] = {};
+        riceReader.ReadRiceArray(2, riceValues);
+        const uint32_t unaryZeroCount = riceReader.ReadUnary();
+        printf("    Rice k=2: "); PrintValues(riceValues);
+        printf(", unary until end: %u zeros, bit offset %zu\n", unaryZeroCount, riceReader.GetBitOffset());
+    }
+    printf("\n");
+
+    printf("Test Huffman decoding:\n");
+    {
+        // The RFC 1951 example code for symbols ABCDEFGH: F=00 A=010 B=011 C=100 D=101 E=110 G=1110 H=1111.
+        // Encoded message "FACEHG", both LSB-first (Deflate) and MSB-first (JPEG).
+        uint8_t codeBitSizes[] = {3, 3, 3, 3, 3, 2, 4, 4};
+        uint8_t messageLe[8] = {0x28, 0xFB, 0x03};
+        uint8_t messageBe[8] = {0x14, 0xDF, 0xC0};
+        uint32_t symbolsLe[6] = {};
+        uint32_t symbolsBe[6] = {};
+
+        HuffmanDecoder<std::endian::little> decoderLe;
+        HuffmanDecoder<std::endian::big> decoderBe;
+        decoderLe.Initialize(codeBitSizes, /*rootBitSize*/ 2); // Small root table to exercise subtables.
+        decoderBe.Initialize(codeBitSizes, /*rootBitSize*/ 2);
+        BitReader<std::endian::little> readerLe(messageLe);
+        BitReader<std::endian::big> readerBe(messageBe);
+        decoderLe.DecodeSymbols(readerLe, symbolsLe);
+        decoderBe.DecodeSymbols(readerBe, symbolsBe);
+        printf("    LE symbols: "); PrintValues(symbolsLe); printf(", bit offset %zu\n", readerLe.GetBitOffset());
+        printf("    BE symbols: "); PrintValues(symbolsBe); printf(", bit offset %zu\n", readerBe.GetBitOffset());
+
+        // The same code in JPEG's counts-per-bit-size form, but omitting H so 1111 is unassigned.
+        uint16_t codeCounts[] = {0, 1, 5, 1};
+        uint16_t codeSymbols[] = {5, 0, 1, 2, 3, 4, 6};
+        HuffmanDecoder<std::endian::big> incompleteDecoder;
+        incompleteDecoder.Initialize(codeCounts, codeSymbols);
+        readerBe.Seek(0);
+        const size_t decodedCount = incompleteDecoder.DecodeSymbols(readerBe, symbolsBe);
+        printf("    BE incomplete code: %zu symbols before invalid code, ", decodedCount);
+        printf("next symbol %X, bit offset %zu\n", incompleteDecoder.DecodeSymbol(readerBe), readerBe.GetBitOffset());
+
+        uint8_t overSubscribedCodeBitSizes[] = {1, 1, 1};
+        printf("    over-subscribed code valid: %d\n", decoderLe.Initialize(overSubscribedCodeBitSizes));
+    }
+    printf("\n");
+
+    printf("Test varints:\n");
+    {
+        constexpr uint64_t values[] = {0, 1, 127, 128, 300, 16384, 0xFFFFFFFF, 0xFFFFFFFFFFFFFFFF};
+        uint8_t encodedBytes[40] = {};
+        size_t byteOffset = 0;
+        for (uint64_t value : values)
+        {
+            WriteVarint(/*inout*/ encodedBytes, /*inout*/ byteOffset, value);
+        }
+        printf("    encoded %zu bytes: ", byteOffset); PrintBytes(std::span(encodedBytes, byteOffset)); printf("\n");
+
+        uint64_t decodedValues[std::size(values)] = {};
+        size_t decodedByteOffset = 0;
+        const size_t decodedCount = ReadVarintArray(std::span(encodedBytes, byteOffset), /*inout*/ decodedByteOffset, decodedValues);
+        printf("    decoded %zu values: ", decodedCount);
+        for (size_t i = 0; i < decodedCount; ++i)
+        {
+            printf((i == 0) ? "%llX" : ",%llX", (unsigned long long)decodedValues[i]);
+        }
+        printf("\n");
+
+        // Varints between bit-packed fields.
+        auto testBitOffset = [](std::endian endianness, char const* endiannessName)
+        {
+            uint8_t bytes[8] = {};
+            size_t bitOffset = 3;
+            WriteVarintAtBitOffset(/*inout*/ bytes, /*inout*/ bitOffset, endianness, 300);
+            WriteVarintAtBitOffset(/*inout*/ bytes, /*inout*/ bitOffset, endianness, 5);
+            size_t readBitOffset = 3;
+            const uint64_t firstValue = ReadVarintAtBitOffset(bytes, /*inout*/ readBitOffset, endianness);
+            const uint64_t secondValue = ReadVarintAtBitOffset(bytes, /*inout*/ readBitOffset, endianness);
+            printf("    %s @3: ", endiannessName); PrintBytes(std::span(bytes, 4));
+            printf(", read %llu,%llu, bit offset %zu\n", (unsigned long long)firstValue, (unsigned long long)secondValue, readBitOffset);
+        };
+        testBitOffset(std::endian::little, "LE");
+        testBitOffset(std::endian::big, "BE");
+    }
+    printf("\n");
+
+    printf("Test copying bit ranges:\n");
+    {
+        // Concatenate a 13-bit field of ones and an 80-bit payload into a stream.
+        uint8_t payload[10] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x55, 0xAA};
+        auto testConcatenation = [&](std::endian endianness, char const* endiannessName)
+        {
+            uint8_t stream[13] = {};
+            WriteBitString(/*inout*/ stream, 0, 13, endianness, 0x1FFF);
+            CopyBits(/*inout*/ stream, 13, payload, 0, sizeof(payload) * CHAR_BIT, endianness);
+            printf("    %s concatenated: ", endiannessName); PrintBytes(stream); printf("\n");
+
+            // Move it back in place (overlapping), restoring the payload.
+            CopyBits(/*inout*/ stream, 0, stream, 13, sizeof(payload) * CHAR_BIT, endianness);
+            printf("    %s moved back:   ", endiannessName); PrintBytes(stream); printf("\n");
+        };
+        testConcatenation(std::endian::little, "LE");
+        testConcatenation(std::endian::big, "BE");
+    }
+    printf("\n");
+
+    printf("Test bit range operations:\n");
+    {
+        auto testBitRanges = [](bool reversedBitsInByte, char const* bitOrderName)
+        {
+            uint8_t bytes[6] = {};
+            SetBitRange(/*inout*/ bytes, 3, 30, reversedBitsInByte);
+            printf("    %s set 3-32:        ", bitOrderName); PrintBytes(bytes); printf("\n");
+            ClearBitRange(/*inout*/ bytes, 12, 6, reversedBitsInByte);
+            printf("    %s clear 12-17:     ", bitOrderName); PrintBytes(bytes); printf("\n");
+            FlipBitRange(/*inout*/ bytes, 6, 36, reversedBitsInByte);
+            printf("    %s flip 6-41:       ", bitOrderName); PrintBytes(bytes); printf("\n");
+            FillBitRange(/*inout*/ bytes, 20, 24, reversedBitsInByte, 0x5A);
+            printf("    %s fill 20-43 (5A): ", bitOrderName); PrintBytes(bytes); printf("\n");
+        };
+        testBitRanges(false, "normal  ");
+        testBitRanges(true,  "reversed");
+    }
+    printf("\n");
+
+    printf("Test single bit operations:\n");
+    {
+        uint8_t visited[4] = {};
+        const size_t randomBitOffsets[] = {9, 30, 2, 9, 17, 100};
+        const size_t sortedBitOffsets[] = {1, 2, 2, 3, 24, 31};
+        bool wasSet[std::size(randomBitOffsets)] = {};
+
+        const size_t newlySetCount = TestAndSetSingleBits(/*inout*/ visited, randomBitOffsets, false, wasSet);
+        printf("    test and set 9,30,2,9,17,100: %zu newly set, was set ", newlySetCount);
+        for (size_t i = 0; i < std::size(wasSet); ++i)
+        {
+            printf((i == 0) ? "%d" : ",%d", wasSet[i]);
+        }
+        printf(", bytes "); PrintBytes(visited); printf("\n");
+
+        ToggleSingleBits(/*inout*/ visited, sortedBitOffsets, false);
+        printf("    toggle 1,2,2,3,24,31: "); PrintBytes(visited); printf("\n");
+
+        ClearSingleBit(/*inout*/ visited, 30, false);
+        ToggleSingleBit(/*inout*/ visited, 0, true);
+        printf("    clear 30, toggle reversed 0: "); PrintBytes(visited);
+        printf(", test 7 = %d, test reversed 7 = %d\n", TestSingleBit(visited, 7, false), TestSingleBit(visited, 7, true));
+    }
+    printf("\n");
+
+    printf("Test counting bits:\n");
+    {
+        std::vector<uint8_t> bitmap(1000);
+        for (size_t i = 0; i < bitmap.size(); ++i)
+        {
+            bitmap[i] = static_cast<uint8_t>(i * 37);
+        }
+        const uint8_t bytes[] = {0xF0,0x0F,0xFF,0x01};
+        printf("    bytes F0,0F,FF,01 normal 2-21: %zu, reversed 2-21: %zu, reversed 30-31: %zu\n",
+            CountBits(bytes, 2, 20, false),
+            CountBits(bytes, 2, 20, true),
+            CountBits(bytes, 30, 2, true)
+        );
+        printf("    1000 bytes (i*37) all: %zu, 13-7900: %zu, past end: %zu\n",
+            CountBits(bitmap, 0, bitmap.size() * CHAR_BIT, false),
+            CountBits(bitmap, 13, 7888, false),
+            CountBits(bitmap, 7990, 100, false)
+        );
+    }
+    printf("\n");
+
+    printf("Test rank/select index:\n");
+    {
+        // Every third bit set, except for an empty stretch in the middle.
+        std::vector<uint8_t> bitmap(2000);
+        for (size_t bitOffset = 0; bitOffset < bitmap.size() * CHAR_BIT; bitOffset += 3)
+        {
+            SetSingleBit(/*inout*/ bitmap, bitOffset, false);
+        }
+        ClearBitRange(/*inout*/ bitmap, 4000, 6000, false);
+
+        RankSelectIndex index;
+        index.Initialize(bitmap, false);
+        printf("    set bits: %zu, rank 0/1/3000/10000/16000: %zu,%zu,%zu,%zu,%zu\n",
+            index.GetSetBitCount(),
+            index.Rank(0),
+            index.Rank(1),
+            index.Rank(3000),
+            index.Rank(10000),
+            index.Rank(16000)
+        );
+        printf("    select 0/1/1333/1334/3333/3334: %zu,%zu,%zu,%zu,%zu,%zd\n",
+            index.Select(0),
+            index.Select(1),
+            index.Select(1333),
+            index.Select(1334),
+            index.Select(3333),
+            static_cast<ptrdiff_t>(index.Select(3334)) // Not found.
+        );
+
+        std::vector<uint8_t> serialized(index.GetSerializedByteSize());
+        RankSelectIndex loadedIndex;
+        const bool isLoaded = index.Serialize(serialized) && loadedIndex.Deserialize(serialized, bitmap);
+        printf("    serialized %zu bytes, loaded: %d, select 2000: %zu\n", serialized.size(), isLoaded, loadedIndex.Select(2000));
+
+        // Corrupted indices are rejected, leaving the loaded index unchanged. A dense bitmap has enough
+        // set bits for several select samples (one per 8192).
+        std::vector<uint8_t> denseBitmap(20000, 0xFF);
+        RankSelectIndex denseIndex;
+        denseIndex.Initialize(denseBitmap, false);
+        std::vector<uint8_t> corrupted(denseIndex.GetSerializedByteSize());
+        denseIndex.Serialize(corrupted);
+        const size_t sampleCount = (denseIndex.GetSetBitCount() + 8191) / 8192;
+        uint8_t* samples = corrupted.data() + corrupted.size() - sampleCount * sizeof(uint32_t);
+        std::swap_ranges(samples, samples + sizeof(uint32_t), samples + (sampleCount - 1) * sizeof(uint32_t));
+        const bool isSwappedSamplesLoaded = loadedIndex.Deserialize(corrupted, denseBitmap);
+        denseIndex.Serialize(corrupted);
+        corrupted[3 * sizeof(uint64_t) + 2 * sizeof(uint64_t)] ^= 1; // Rank of the second block.
+        const bool isBadRankLoaded = loadedIndex.Deserialize(corrupted, denseBitmap);
+        printf("    %zu samples swapped loaded: %d, bad block rank loaded: %d, select 2000: %zu\n",
+            sampleCount, isSwappedSamplesLoaded, isBadRankLoaded, loadedIndex.Select(2000)
+        );
+    }
+    printf("\n");
+
+    printf("Test finding bits:\n");
+    {
+        // A sparse bitmap with a few set bits and a clear stretch in an otherwise full region.
+        std::vector<uint8_t> bitmap(1000);
+        const size_t setBitOffsets[] = {5, 700, 4093, 7999};
+        SetSingleBits(/*inout*/ bitmap, setBitOffsets, false);
+        SetBitRange(/*inout*/ bitmap, 1000, 2000, false);
+        ClearBitRange(/*inout*/ bitmap, 1500, 3, false);
+
+        // Print the sparse bits, and just the count and sum of those in the dense run 1000-2999.
+        size_t denseSetBitCount = 0;
+        size_t denseSetBitSum = 0;
+        printf("    set bits:");
+        ForEachSetBit(bitmap, false, [&](size_t bitOffset)
+        {
+            if (bitOffset >= 1000 && bitOffset < 3000)
+            {
+                ++denseSetBitCount;
+                denseSetBitSum += bitOffset;
+            }
+            else
+            {
+                printf(" %zu", bitOffset);
+            }
+        });
+        printf(", and %zu in 1000-2999 summing to %zu\n", denseSetBitCount, denseSetBitSum);
+        printf("    next set from 6/701/3000: %zu,%zu,%zu, next clear from 1000/1503: %zu,%zu\n",
+            FindNextSetBit(bitmap, 6, false),
+            FindNextSetBit(bitmap, 701, false),
+            FindNextSetBit(bitmap, 3000, false),
+            FindNextClearBit(bitmap, 1000, false),
+            FindNextClearBit(bitmap, 1503, false)
+        );
+        printf("    prev set from 999/4092/end: %zu,%zu,%zu, next set after last: %zd\n",
+            FindPrevSetBit(bitmap, 999, false),
+            FindPrevSetBit(bitmap, 4092, false),
+            FindPrevSetBit(bitmap, bitOffsetNotFound, false),
+            static_cast<ptrdiff_t>(FindNextSetBit(bitmap, 8000, false))
+        );
+
+        const uint8_t reversedBytes[] = {0x00,0x00,0x20,0x00,0x00,0x00,0x00,0x00,0x00,0x80};
+        printf("    reversed set bits: %zu,%zu, prev from 71: %zu\n",
+            FindNextSetBit(reversedBytes, 0, true),
+            FindNextSetBit(reversedBytes, 19, true),
+            FindPrevSetBit(reversedBytes, 71, true)
+        );
+    }
+    printf("\n");
+
+    printf("Test combining bit ranges:\n");
+    {
+        const uint8_t a[] = {0xF0,0xFF,0x0F,0x33,0x55,0xAA,0xC3,0x3C,0x81,0x7E};
+        const uint8_t b[] = {0xFF,0x00,0xFF,0x00,0xFF,0x00,0xFF,0x00,0xFF,0x00};
+        auto testCombineBits = [&](BitOperation operation, char const* operationName)
+        {
+            // 70 bits of a from bit 4 with b from bit 1, into bit 3 of the destination.
+            uint8_t bytes[10] = {};
+            CombineBits(/*inout*/ bytes, 3, a, 4, b, 1, 70, operation, std::endian::little);
+            printf("    LE %-7s ", operationName); PrintBytes(bytes); printf("\n");
+        };
+        testCombineBits(BitOperation::And, "and:");
+        testCombineBits(BitOperation::Or, "or:");
+        testCombineBits(BitOperation::Xor, "xor:");
+        testCombineBits(BitOperation::AndNot, "andnot:");
+
+        // In place, with the destination as the first source.
+        uint8_t bytes[10];
+        std::copy(std::begin(a), std::end(a), bytes);
+        CombineBits(/*inout*/ bytes, 2, bytes, 2, b, 0, 76, BitOperation::Xor, std::endian::big);
+        printf("    BE xor in place: "); PrintBytes(bytes); printf("\n");
+    }
+    printf("\n");
+
+    printf("Test shifting bits:\n");
+    {
+        // A 5-bit header (10110) followed by the payload bytes 12,34,56,78,9A in BE bit order.
+        const uint8_t packet[] = {0xB0,0x91,0xA2,0xB3,0xC4,0xD0,0x00,0x00};
+        uint8_t payload[5];
+        ShiftBits(/*out*/ payload, packet, 5, 40, std::endian::big);
+        printf("    BE payload after 5-bit header: "); PrintBytes(payload); printf("\n");
+
+        uint8_t bytes[8] = {0x12,0x34,0x56,0x78,0x9A,0xBC,0xDE,0xF0};
+        ShiftBits(/*inout*/ bytes, -12, 64, std::endian::little);
+        printf("    LE in place by -12: "); PrintBytes(bytes); printf("\n");
+        ShiftBits(/*inout*/ bytes, 12, 64, std::endian::little);
+        printf("    LE in place by 12:  "); PrintBytes(bytes); printf("\n");
+    }
+    printf("\n");
+
+    printf("Test converting endianness:\n");
+    {
+        // Four 13-bit samples 0x1ABC,0x0123,0x1FFF,0x0000 captured in BE bit order.
+        const uint8_t beSamples[] = {0xD5,0xE0,0x48,0xFF,0xFE,0x00,0x00};
+        uint8_t leSamples[7] = {};
+        ConvertBitStringEndianness(/*out*/ leSamples, beSamples, 13, 4, std::endian::big, std::endian::little);
+        printf("    13-bit BE->LE: "); PrintBytes(leSamples); printf("\n");
+        uint32_t values[4];
+        ReadBitStringArray(leSamples, 0, 13, std::endian::little, /*out*/ values);
+        printf("    13-bit LE values: %X,%X,%X,%X\n", values[0], values[1], values[2], values[3]);
+
+        uint8_t nibbles[4] = {0x12,0x34,0x56,0x78};
+        ConvertBitStringEndianness(/*inout*/ nibbles, nibbles, 4, 8, std::endian::big, std::endian::little);
+        printf("    4-bit in place: "); PrintBytes(nibbles); printf("\n");
+        uint8_t words[6] = {0x12,0x34,0x56,0x78,0x9A,0xBC};
+        ConvertBitStringEndianness(/*inout*/ words, words, 16, 3, std::endian::little, std::endian::big);
+        printf("    16-bit in place: "); PrintBytes(words); printf("\n");
+    }
+    printf("\n");
+
+    printf("Test reversing bits:\n");
+    {
+        // Bits 0,1,9 set in LSB-first order become bits 0,1,9 in MSB-first order.
+        const uint8_t lsbFirst[] = {0x03,0x02};
+        uint8_t msbFirst[2];
+        ReverseBitsInBytes(/*out*/ msbFirst, lsbFirst);
+        printf("    LSB-first to MSB-first: "); PrintBytes(msbFirst); printf("\n");
+
+        uint8_t bytes[4] = {0x12,0x34,0x56,0x78};
+        ReverseBitRange(/*inout*/ bytes, 0, 32, false);
+        printf("    Whole range reversed: "); PrintBytes(bytes); printf("\n");
+        ReverseBitRange(/*inout*/ bytes, 0, 32, false);
+        ReverseBitRange(/*inout*/ bytes, 4, 16, false);
+        printf("    LE bits 4-19 reversed: "); PrintBytes(bytes); printf("\n");
+        ReverseBitRange(/*inout*/ bytes, 4, 16, false);
+        ReverseBitRange(/*inout*/ bytes, 3, 6, true);
+        printf("    BE bits 3-8 reversed: "); PrintBytes(bytes); printf("\n");
+    }
+    printf("\n");
+
+    printf("Test packed array:\n");
+    {
+        PackedArray<13, std::endian::big> samples(4);
+        samples[0] = 0x1ABC;
+        samples[1] = 0x0123;
+        samples[2] = 0xFFFF; // Masked to 0x1FFF.
+        samples.push_back(0x0042);
+        std::sort(samples.begin(), samples.end());
+        printf("    Sorted 13-bit BE (%zu bytes, capacity %zu): ", samples.size_bytes(), samples.capacity());
+        char const* separator = "";
+        for (uint32_t sample : samples)
+        {
+            printf("%s%X", separator, sample);
+            separator = ",";
+        }
+        printf("\n    Bytes: "); PrintBytes(std::span<uint8_t const>(samples.data(), samples.size_bytes())); printf("\n");
+
+        PackedArray<13, std::endian::big> moved = std::move(samples);
+        PackedArray<13, std::endian::big> cloned = moved.Clone();
+        moved.Fill(0x0555);
+        uint32_t values[5];
+        cloned.CopyTo(0, values);
+        printf("    Moved-from size: %zu, cloned: %X,%X,%X,%X,%X, filled: %X,%X\n", samples.size(), values[0], values[1], values[2], values[3], values[4], uint32_t(moved[0]), uint32_t(moved[4]));
+    }
+    printf("\n");
+
+    printf("Test backward bit reader:\n");
+    {
+        // Write fields forward, then decode them last-to-first like an FSE stream.
+        constexpr uint32_t fieldBitSizes[] = {3, 13, 7, 32, 1, 20, 9};
+        constexpr uint32_t fieldValues[]   = {5, 0x1ABC, 0x55, 0xDEADBEEF, 1, 0xF00D5, 0x123};
+        constexpr size_t fieldCount = std::size(fieldBitSizes);
+
+        auto testBackward = [&]<std::endian endianness>(char const* endiannessName)
+        {
+            std::vector<uint8_t> stream;
+            BitWriter<endianness> writer(stream);
+            for (size_t i = 0; i < fieldCount; ++i)
+            {
+                writer.Write(fieldBitSizes[i], fieldValues[i]);
+            }
+            const size_t endBitOffset = writer.GetBitOffset();
+            writer.Flush();
+
+            BackwardBitReader<endianness> reader(stream, endBitOffset);
+            printf("    %s fields from end: ", endiannessName);
+            for (size_t i = fieldCount; i-- > 0; )
+            {
+                printf((i == fieldCount - 1) ? "%X" : ",%X", reader.Read(fieldBitSizes[i]));
+            }
+            printf(", remaining bits: %zu, read before front: %X\n", reader.GetBitOffset(), reader.Read(8));
+        };
+        testBackward.template operator()<std::endian::little>("LE");
+        testBackward.template operator()<std::endian::big>("BE");
+    }
+    printf("\n");
+
+    printf("Test gathering/scattering multiple bit fields:\n");
+    {
+        constexpr uint64_t value = 0x0123456789ABCDEF;
+        constexpr uint64_t fieldMask = 0xFF0000F00F0000FF; // 4 separate fields.
+        const uint64_t gatheredValue = GatherBits(value, fieldMask);
+        const uint64_t scatteredValue = ScatterBits(gatheredValue, fieldMask);
+        printf("    GatherBits(%016llX, %016llX): %llX\n", (unsigned long long)value, (unsigned long long)fieldMask, (unsigned long long)gatheredValue);
+        printf("    ScatterBits(%llX, %016llX): %016llX\n", (unsigned long long)gatheredValue, (unsigned long long)fieldMask, (unsigned long long)scatteredValue);
+
+        // Write 3 nibble-sized fields into a 24-bit window, then read them back together.
+        uint8_t bufferLe[4] = {};
+        uint8_t bufferBe[4] = {};
+        constexpr size_t bitOffset = 3;
+        constexpr size_t bitSize = 24;
+        constexpr uint32_t windowFieldMask = 0xF00F0F;
+        WriteBitFields(bufferLe, bitOffset, bitSize, std::endian::little, windowFieldMask, 0xD5A);
+        WriteBitFields(bufferBe, bitOffset, bitSize, std::endian::big,    windowFieldMask, 0xD5A);
+
+        printf("    LE %zu-bit fields @%zu: %X\n", bitSize, bitOffset, ReadBitFields(bufferLe, bitOffset, bitSize, std::endian::little, windowFieldMask));
+        printf("             as bytes: "); PrintBytes(bufferLe); printf("\n");
+        printf("    BE %zu-bit fields @%zu: %X\n", bitSize, bitOffset, ReadBitFields(bufferBe, bitOffset, bitSize, std::endian::big, windowFieldMask));
+        printf("             as bytes: "); PrintBytes(bufferBe); printf("\n");
+
+        // A field mask wider than the 8-bit window only writes the bits within it.
+        uint8_t window[2] = {};
+        WriteBitFields(window, 4, 8, std::endian::little, 0xFF0F, 0xFFF);
+        printf("    LE 8-bit window @4 with mask FF0F: "); PrintBytes(window); printf("\n");
+    }
+    printf("\n");
 }